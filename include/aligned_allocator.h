@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <limits>
+
+namespace geom {
+
+    // Allocator returning memory aligned to a SIMD (cache line) boundary
+    template <typename T, std::size_t Alignment = 64>
+    struct AlignedAllocator
+    {
+        using value_type = T;
+
+        // Rebind to another value type keeping the alignment
+        template <typename U>
+        struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+        AlignedAllocator() noexcept {}
+
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+        // Allocate n elements
+        T* allocate(std::size_t n)
+        {
+            if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            {
+                throw std::bad_array_new_length();
+            }
+
+            return static_cast<T*>(::operator new(n * sizeof(T),
+                std::align_val_t(Alignment)));
+        }
+
+        // Deallocate n elements
+        void deallocate(T* ptr, std::size_t) noexcept
+        {
+            ::operator delete(ptr, std::align_val_t(Alignment));
+        }
+    };
+
+    template <typename T, typename U, std::size_t Alignment>
+    bool operator==(const AlignedAllocator<T, Alignment>&,
+        const AlignedAllocator<U, Alignment>&) { return true; }
+
+    template <typename T, typename U, std::size_t Alignment>
+    bool operator!=(const AlignedAllocator<T, Alignment>&,
+        const AlignedAllocator<U, Alignment>&) { return false; }
+}
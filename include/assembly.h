@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <armadillo>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "geom.h"
+#include "support_domain.h"
+
+// Assembly of the global matrices and vectors over the quadrature points
+namespace assembly {
+
+    // Quadrature point of an integration cell
+    struct QuadraturePoint
+    {
+        // Index of the point in the support domain table
+        size_t idx;
+
+        // Integration weight (quadrature weight * cell measure * thickness)
+        double weight;
+    };
+
+    /**
+    * Greedy colouring of quadrature points; the points of a colour share no
+    * support node, so their contributions touch disjoint global dofs and can
+    * be accumulated concurrently without conflicts.
+    *
+    * @param sd_table Support domain table.
+    * @param points Quadrature points (indices into the table).
+    * @param nodes_num Number of field nodes.
+    * @return Positions in points of the points of each colour.
+    */
+    template <typename T>
+    std::vector<std::vector<size_t>> colour_points(const
+        typename SupportDomain<T>::SupportDomainTable& sd_table,
+        const std::vector<QuadraturePoint>& points, size_t nodes_num);
+
+    // Number of threads of the parallel regions
+    inline size_t max_threads(void)
+    {
+#ifdef _OPENMP
+        return (size_t) omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    // Index of the calling thread within a parallel region
+    inline size_t thread_num(void)
+    {
+#ifdef _OPENMP
+        return (size_t) omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    /* Number of threads of the current team; it may be lower than requested
+    (dynamic adjustment, nested regions) */
+    inline size_t team_size(void)
+    {
+#ifdef _OPENMP
+        return (size_t) omp_get_num_threads();
+#else
+        return 1;
+#endif
+    }
+}
@@ -15,28 +15,22 @@ class BoundaryConditions
         BoundaryConditions(const Mesh2D& mesh_raw);
 
         // Get mesh
-        Mesh2D get_mesh(void) { return m_mesh; }
+        const Mesh2D& get_mesh(void) const { return m_mesh; }
 
         // Get number of boundaries 
-        size_t get_number_of_boundaries(void) { return m_boundaries_num; }
+        size_t get_number_of_boundaries(void) const { return m_boundaries_num; }
 
     private: 
 
-        // Raw mesh
-        Mesh2D m_mesh_raw;
-
         // Triangular mesh
         Mesh2D m_mesh;
 
-        // Triangular mesh initial
-        Mesh2D m_mesh_initial;
-
     private:
         // Boundary x scale factor
         double m_bound_x_scale_factor = 0.02;
 
         // Set boundary point indices
-        void set_boundary_pts_indices(void);
+        void set_boundary_pts_indices(const Mesh2D& mesh_raw);
 
         // Boundary points indices
         std::vector<size_t> m_boundary_pts_indices;
@@ -54,9 +48,9 @@ class BoundaryConditions
         void update_boundaries(void);
 
         // Generate mesh for field notes
-        void generate_field_nodes_mesh(void);
+        void generate_field_nodes_mesh(const Mesh2D& mesh_raw);
 
         // Get the index of a specified element in a vector
-        size_t get_index_of_specified_value(std::vector<size_t> v,
+        size_t get_index_of_specified_value(const std::vector<size_t>& v,
             size_t k);
 };
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <armadillo>
+
+/* Block compressed sparse row matrix of 2 x 2 blocks (the couplings of two
+nodes of a plane elasticity model) with 32-bit indices. A symmetric matrix
+stores only the blocks of the upper block triangle (block column >= block
+row); the diagonal blocks are stored whole. The values of a block are
+contiguous and row major, [a00, a01, a10, a11].
+
+The pattern is set once by the symbolic phase of an assembly, which also
+resolves the block slot of every contribution; the numeric phase then only
+accumulates into the values in place. */
+class BSRMatrix
+{
+public:
+    // Block size
+    static constexpr size_t block_size = 2;
+
+    // Values per block
+    static constexpr size_t block_values = block_size * block_size;
+
+    // Index type
+    using Index = std::uint32_t;
+
+    // Slot of the discarded blocks (lower triangle of a symmetric matrix)
+    static constexpr Index discarded = std::numeric_limits<Index>::max();
+
+    BSRMatrix() {}
+
+    /**
+    * Sets the pattern and zeroes the values.
+    *
+    * @param n_block_rows, n_block_cols Matrix size in blocks.
+    * @param row_ptr Block row r spans [row_ptr[r], row_ptr[r+1]).
+    * @param col_idx Block column indices (sorted within each block row; only
+    * the upper block triangle if symmetric).
+    * @param symmetric Upper block triangle storage.
+    */
+    void set_pattern(size_t n_block_rows, size_t n_block_cols,
+        std::vector<Index> row_ptr, std::vector<Index> col_idx, bool symmetric);
+
+    /**
+    * Block slot of a block of the pattern (binary search; symbolic phase).
+    *
+    * @return Block slot (the values start at block_values * slot), discarded
+    * for the lower triangle of a symmetric matrix, or the number of blocks if
+    * the block is not in the pattern.
+    */
+    Index slot(size_t block_row, size_t block_col) const;
+
+    /**
+    * Adds a weighted local matrix of ns x ns node blocks (2 ns x 2 ns, local
+    * dof 2 i + c is component c of node i) to the block values (assembly
+    * kernel).
+    *
+    * @param k_local Local matrix.
+    * @param weight Weight of the local matrix.
+    * @param slots Block slot of each node pair (i, j), at j * ns + i.
+    * @param values Block values the slots refer to.
+    */
+    static void add_local(const arma::dmat& k_local, double weight,
+        const Index* slots, double* values);
+
+    // Zero the values (the pattern is kept)
+    void zeros(void) { std::fill(m_values.begin(), m_values.end(), 0.0); }
+
+    // y = A x
+    arma::dvec multiply(const arma::dvec& x) const;
+
+    // Armadillo (compressed column) copy; a symmetric matrix is expanded
+    arma::sp_mat to_sp_mat(void) const;
+
+    // Get number of rows
+    size_t get_n_rows(void) const { return block_size * m_n_block_rows; }
+
+    // Get number of columns
+    size_t get_n_cols(void) const { return block_size * m_n_block_cols; }
+
+    // Get number of stored blocks
+    size_t get_blocks_num(void) const { return m_col_idx.size(); }
+
+    // Upper block triangle storage
+    bool is_symmetric(void) const { return m_symmetric; }
+
+    // Get block row offsets
+    const std::vector<Index>& get_row_ptr(void) const { return m_row_ptr; }
+
+    // Get block column indices
+    const std::vector<Index>& get_col_idx(void) const { return m_col_idx; }
+
+    // Get values
+    const std::vector<double>& get_values(void) const { return m_values; }
+
+    // Values (accumulated in place by the numeric phase)
+    std::vector<double>& values(void) { return m_values; }
+
+private:
+    // Matrix size in blocks
+    size_t m_n_block_rows = 0, m_n_block_cols = 0;
+
+    // Upper block triangle storage
+    bool m_symmetric = false;
+
+    // Pattern
+    std::vector<Index> m_row_ptr = {0}, m_col_idx;
+
+    // Values
+    std::vector<double> m_values;
+};
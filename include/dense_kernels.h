@@ -0,0 +1,915 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <cstddef>
+#include <algorithm>
+#include <armadillo>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+/* Small dense kernels operating in place on (fixed or dynamic) Armadillo
+matrices. Only the leading n x n block of the matrices is referenced, so
+padded storage can be used. The sparse variants keep the dense storage but
+skip the structural zeros. The lockstep variants process W interleaved
+matrices at once (raw storage).
+
+The moment matrices of the RPIM are symmetric indefinite (saddle point
+systems, and kernels such as the multiquadric with q > 1 are indefinite by
+themselves), so they are factorised with the Bunch-Kaufman pivoting of
+ldlt_factorise_pivoted. The unpivoted variants are meant for definite
+matrices, or as a fast first attempt: they fail on element growth, and the
+caller then falls back to the pivoted factorisation. */
+namespace dense {
+
+    /* Element growth accepted by the unpivoted factorisations: each
+    elimination step may add at most growth_limit times the largest entry of
+    the matrix to the trailing entries */
+    constexpr double growth_limit = 1.0e3;
+
+    /* Pivots of ldlt_factorise_pivoted: p[k] >= 0 for a 1 x 1 pivot (rows k
+    and p[k] interchanged), p[k] = p[k + 1] = -(r + 1) for a 2 x 2 pivot
+    (rows k + 1 and r interchanged) */
+    using Pivot = std::ptrdiff_t;
+
+    // Read only view of an n x n column major matrix in a flat buffer
+    template <typename S>
+    struct MatrixView
+    {
+        const S* data;
+        size_t n;
+
+        S at(size_t i, size_t j) const { return data[j * n + i]; }
+    };
+
+    /* Flushes denormal results and operands to zero while in scope (SSE
+    control register; no effect on other targets). Single precision
+    eliminations of decaying kernels underflow often, and denormal
+    arithmetic is slow. */
+    class FlushDenormals
+    {
+    public:
+#if defined(__SSE__)
+        FlushDenormals(void) : m_csr(_mm_getcsr()) { _mm_setcsr(m_csr | 0x8040); }
+        ~FlushDenormals(void) { _mm_setcsr(m_csr); }
+
+    private:
+        // Previous control register
+        unsigned int m_csr;
+#else
+        FlushDenormals(void) {}
+#endif
+    };
+
+    /**
+    * In place LDL^T factorisation of a symmetric matrix without pivoting.
+    * The lower triangle of a is referenced. On exit, the strict lower
+    * triangle holds L (unit diagonal) and the diagonal holds D. It is carried
+    * out in the element type of a (float or double).
+    *
+    * @param a Symmetric matrix; overwritten by the factors.
+    * @param n Size of the leading block to factorise.
+    * @return False if a pivot is zero or not finite (relative to the largest
+    * entry of a), or if the element growth exceeds growth_limit; the factors
+    * are then incomplete.
+    */
+    template <typename MatType>
+    bool ldlt_factorise(MatType& a, size_t n)
+    {
+        // Scalar type of the factorisation (float or double)
+        using S = typename MatType::elem_type;
+
+        // Scale for the pivot test
+        S scale = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t i = j; i < n; i++)
+            {
+                scale = std::max(scale, std::abs(a.at(i, j)));
+            }
+        }
+
+        S tol = n * std::numeric_limits<S>::epsilon() * scale;
+        S growth = (S) growth_limit * scale;
+
+        // Right looking elimination (column oriented)
+        for (size_t j = 0; j < n; j++)
+        {
+            S d = a.at(j, j);
+
+            if (!std::isfinite(d) || std::abs(d) <= tol)
+            {
+                return false;
+            }
+
+            // Element growth of this step; max |a_ij|^2 / |d|
+            S colmax = 0;
+            for (size_t i = j + 1; i < n; i++)
+            {
+                colmax = std::max(colmax, std::abs(a.at(i, j)));
+            }
+
+            if (colmax * colmax > growth * std::abs(d))
+            {
+                return false;
+            }
+
+            // Update the trailing lower triangle
+            for (size_t k = j + 1; k < n; k++)
+            {
+                S f = a.at(k, j) / d;
+
+                for (size_t i = k; i < n; i++)
+                {
+                    a.at(i, k) -= a.at(i, j) * f;
+                }
+            }
+
+            // Column j of L
+            for (size_t i = j + 1; i < n; i++)
+            {
+                a.at(i, j) /= d;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+    * In place LDL^T factorisation (see ldlt_factorise) of a sparse symmetric
+    * matrix in dense storage. Each column is eliminated over its non zero
+    * rows only, so the work scales with the non zeros of L rather than n^3.
+    * The factors are the same as those of ldlt_factorise.
+    *
+    * @param a Symmetric matrix; overwritten by the factors.
+    * @param n Size of the leading block to factorise.
+    * @param rows Scratch memory of size at least n.
+    * @return False if a pivot is zero or not finite, or on element growth.
+    */
+    template <typename MatType>
+    bool ldlt_factorise_sparse(MatType& a, size_t n, size_t* rows)
+    {
+        // Scalar type of the factorisation (float or double)
+        using S = typename MatType::elem_type;
+
+        // Scale for the pivot test
+        S scale = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t i = j; i < n; i++)
+            {
+                scale = std::max(scale, std::abs(a.at(i, j)));
+            }
+        }
+
+        S tol = n * std::numeric_limits<S>::epsilon() * scale;
+        S growth = (S) growth_limit * scale;
+
+        for (size_t j = 0; j < n; j++)
+        {
+            S d = a.at(j, j);
+
+            if (!std::isfinite(d) || std::abs(d) <= tol)
+            {
+                return false;
+            }
+
+            // Non zero rows of column j below the diagonal
+            size_t nnz = 0;
+            S colmax = 0;
+            for (size_t i = j + 1; i < n; i++)
+            {
+                if (a.at(i, j) != 0)
+                {
+                    rows[nnz++] = i;
+                    colmax = std::max(colmax, std::abs(a.at(i, j)));
+                }
+            }
+
+            // Element growth of this step (see ldlt_factorise)
+            if (colmax * colmax > growth * std::abs(d))
+            {
+                return false;
+            }
+
+            // Dense column (e.g. after fill in); contiguous update
+            if (nnz == n - j - 1)
+            {
+                for (size_t k = j + 1; k < n; k++)
+                {
+                    S f = a.at(k, j) / d;
+
+                    for (size_t i = k; i < n; i++)
+                    {
+                        a.at(i, k) -= a.at(i, j) * f;
+                    }
+                }
+            }
+            else
+            {
+                // Update the trailing lower triangle on the non zero pattern
+                for (size_t p = 0; p < nnz; p++)
+                {
+                    size_t k = rows[p];
+                    S f = a.at(k, j) / d;
+
+                    for (size_t r = p; r < nnz; r++)
+                    {
+                        a.at(rows[r], k) -= a.at(rows[r], j) * f;
+                    }
+                }
+            }
+
+            // Column j of L
+            for (size_t p = 0; p < nnz; p++)
+            {
+                a.at(rows[p], j) /= d;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+    * Solves L D L^T x = b in place for all the columns of b. The
+    * substitutions are carried out in double precision, also for single
+    * precision factors.
+    *
+    * @param ldl Factors from ldlt_factorise.
+    * @param n Size of the factorised block.
+    * @param b Right hand sides; overwritten by the solution.
+    */
+    template <typename MatType, typename RhsType>
+    void ldlt_solve(const MatType& ldl, size_t n, RhsType& b)
+    {
+        for (size_t c = 0; c < b.n_cols; c++)
+        {
+            // Forward substitution; L y = b
+            for (size_t j = 0; j < n; j++)
+            {
+                double y = b.at(j, c);
+
+                for (size_t i = j + 1; i < n; i++)
+                {
+                    b.at(i, c) -= ldl.at(i, j) * y;
+                }
+            }
+
+            // Diagonal; D z = y
+            for (size_t j = 0; j < n; j++)
+            {
+                b.at(j, c) /= ldl.at(j, j);
+            }
+
+            // Backward substitution; L^T x = z
+            for (size_t j = n; j-- > 0;)
+            {
+                double x = b.at(j, c);
+
+                for (size_t i = j + 1; i < n; i++)
+                {
+                    x -= ldl.at(i, j) * b.at(i, c);
+                }
+
+                b.at(j, c) = x;
+            }
+        }
+    }
+
+    /**
+    * In place Bunch-Kaufman factorisation P A P^T = L D L^T of a symmetric
+    * (indefinite) matrix, with D block diagonal of 1 x 1 and 2 x 2 blocks.
+    * The lower triangle of a is referenced. On exit, the diagonal blocks
+    * hold D and the rest of the lower triangle holds L (unit diagonal blocks;
+    * the rows of the previous columns of L are interchanged as well, so P is
+    * a plain permutation). The element growth is bounded, so the
+    * factorisation is stable without further checks. It is carried out in
+    * the element type of a (float or double).
+    *
+    * @param a Symmetric matrix; overwritten by the factors.
+    * @param n Size of the leading block to factorise.
+    * @param piv Output pivots (size n, see Pivot).
+    * @return False if a is singular (a column with no entry above the round
+    * off of the largest entry of a) or not finite.
+    */
+    template <typename MatType>
+    bool ldlt_factorise_pivoted(MatType& a, size_t n, Pivot* piv)
+    {
+        // Scalar type of the factorisation (float or double)
+        using S = typename MatType::elem_type;
+
+        // Pivot choice constant; minimises the element growth bound
+        const S alpha = (S) ((1.0 + std::sqrt(17.0)) / 8.0);
+
+        // Scale for the singularity test
+        S scale = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t i = j; i < n; i++)
+            {
+                scale = std::max(scale, std::abs(a.at(i, j)));
+            }
+        }
+
+        if (!std::isfinite(scale))
+        {
+            return false;
+        }
+
+        S tol = n * std::numeric_limits<S>::epsilon() * scale;
+
+        for (size_t k = 0; k < n;)
+        {
+            // Largest entry of column k below the diagonal
+            S abs_akk = std::abs(a.at(k, k));
+            S colmax = 0;
+            size_t imax = k;
+            for (size_t i = k + 1; i < n; i++)
+            {
+                if (std::abs(a.at(i, k)) > colmax)
+                {
+                    colmax = std::abs(a.at(i, k));
+                    imax = i;
+                }
+            }
+
+            if (!(std::max(abs_akk, colmax) > tol))
+            {
+                return false;
+            }
+
+            // Pivot; 1 x 1 at k, 1 x 1 at imax, or 2 x 2 at (k, imax)
+            size_t kp = k, step = 1;
+            if (abs_akk < alpha * colmax)
+            {
+                // Largest off diagonal entry of row (and column) imax
+                S rowmax = 0;
+                for (size_t j = k; j < imax; j++)
+                {
+                    rowmax = std::max(rowmax, std::abs(a.at(imax, j)));
+                }
+
+                for (size_t i = imax + 1; i < n; i++)
+                {
+                    rowmax = std::max(rowmax, std::abs(a.at(i, imax)));
+                }
+
+                if (abs_akk * rowmax >= alpha * colmax * colmax)
+                {
+                    kp = k;
+                }
+                else if (std::abs(a.at(imax, imax)) >= alpha * rowmax)
+                {
+                    kp = imax;
+                }
+                else
+                {
+                    kp = imax;
+                    step = 2;
+                }
+            }
+
+            // Symmetric interchange of the rows and columns kk and kp
+            size_t kk = k + step - 1;
+            if (kp != kk)
+            {
+                // Rows of L and of the first column of a 2 x 2 pivot
+                for (size_t j = 0; j < kk; j++)
+                {
+                    std::swap(a.at(kk, j), a.at(kp, j));
+                }
+
+                for (size_t j = kk + 1; j < kp; j++)
+                {
+                    std::swap(a.at(j, kk), a.at(kp, j));
+                }
+
+                for (size_t i = kp + 1; i < n; i++)
+                {
+                    std::swap(a.at(i, kk), a.at(i, kp));
+                }
+
+                std::swap(a.at(kk, kk), a.at(kp, kp));
+            }
+
+            if (step == 1)
+            {
+                S d = a.at(k, k);
+
+                // Update the trailing lower triangle
+                for (size_t j = k + 1; j < n; j++)
+                {
+                    S f = a.at(j, k) / d;
+
+                    for (size_t i = j; i < n; i++)
+                    {
+                        a.at(i, j) -= a.at(i, k) * f;
+                    }
+                }
+
+                // Column k of L
+                for (size_t i = k + 1; i < n; i++)
+                {
+                    a.at(i, k) /= d;
+                }
+
+                piv[k] = (Pivot) kp;
+            }
+            else
+            {
+                // 2 x 2 pivot block and its determinant (bounded away from 0)
+                S d11 = a.at(k, k), d21 = a.at(k + 1, k), d22 = a.at(k + 1, k + 1);
+                S det = d11 * d22 - d21 * d21;
+
+                // Update the trailing lower triangle; A22 -= W D^-1 W^T
+                for (size_t j = k + 2; j < n; j++)
+                {
+                    S w1 = a.at(j, k), w2 = a.at(j, k + 1);
+                    S l1 = (d22 * w1 - d21 * w2) / det;
+                    S l2 = (d11 * w2 - d21 * w1) / det;
+
+                    for (size_t i = j; i < n; i++)
+                    {
+                        a.at(i, j) -= a.at(i, k) * l1 + a.at(i, k + 1) * l2;
+                    }
+                }
+
+                // Columns k and k + 1 of L; W D^-1
+                for (size_t i = k + 2; i < n; i++)
+                {
+                    S w1 = a.at(i, k), w2 = a.at(i, k + 1);
+                    a.at(i, k) = (d22 * w1 - d21 * w2) / det;
+                    a.at(i, k + 1) = (d11 * w2 - d21 * w1) / det;
+                }
+
+                piv[k] = piv[k + 1] = -(Pivot) kp - 1;
+            }
+
+            k += step;
+        }
+
+        return true;
+    }
+
+    /**
+    * Solves P^T L D L^T P x = b in place for all the columns of b. The
+    * substitutions are carried out in double precision, also for single
+    * precision factors.
+    *
+    * @param ldl Factors from ldlt_factorise_pivoted.
+    * @param n Size of the factorised block.
+    * @param piv Pivots from ldlt_factorise_pivoted.
+    * @param b Right hand sides; overwritten by the solution.
+    */
+    template <typename MatType, typename RhsType>
+    void ldlt_solve_pivoted(const MatType& ldl, size_t n, const Pivot* piv,
+        RhsType& b)
+    {
+        for (size_t c = 0; c < b.n_cols; c++)
+        {
+            // Interchanges; P b
+            for (size_t k = 0; k < n;)
+            {
+                if (piv[k] >= 0)
+                {
+                    std::swap(b.at(k, c), b.at((size_t) piv[k], c));
+                    k++;
+                }
+                else
+                {
+                    std::swap(b.at(k + 1, c), b.at((size_t) (-piv[k] - 1), c));
+                    k += 2;
+                }
+            }
+
+            // Forward substitution; L y = b
+            for (size_t k = 0; k < n;)
+            {
+                size_t step = piv[k] >= 0 ? 1 : 2;
+
+                for (size_t j = k; j < k + step; j++)
+                {
+                    double y = b.at(j, c);
+
+                    for (size_t i = k + step; i < n; i++)
+                    {
+                        b.at(i, c) -= ldl.at(i, j) * y;
+                    }
+                }
+
+                k += step;
+            }
+
+            // Block diagonal; D z = y
+            for (size_t k = 0; k < n;)
+            {
+                if (piv[k] >= 0)
+                {
+                    b.at(k, c) /= ldl.at(k, k);
+                    k++;
+                }
+                else
+                {
+                    double d11 = ldl.at(k, k), d21 = ldl.at(k + 1, k);
+                    double d22 = ldl.at(k + 1, k + 1);
+                    double det = d11 * d22 - d21 * d21;
+                    double y1 = b.at(k, c), y2 = b.at(k + 1, c);
+
+                    b.at(k, c) = (d22 * y1 - d21 * y2) / det;
+                    b.at(k + 1, c) = (d11 * y2 - d21 * y1) / det;
+                    k += 2;
+                }
+            }
+
+            // Backward substitution; L^T w = z (the blocks from the last)
+            for (size_t k = n; k > 0;)
+            {
+                size_t step = piv[k - 1] >= 0 ? 1 : 2;
+                k -= step;
+
+                for (size_t j = k; j < k + step; j++)
+                {
+                    double x = b.at(j, c);
+
+                    for (size_t i = k + step; i < n; i++)
+                    {
+                        x -= ldl.at(i, j) * b.at(i, c);
+                    }
+
+                    b.at(j, c) = x;
+                }
+            }
+
+            // Interchanges in reverse order; x = P^T w
+            for (size_t k = n; k > 0;)
+            {
+                if (piv[k - 1] >= 0)
+                {
+                    k--;
+                    std::swap(b.at(k, c), b.at((size_t) piv[k], c));
+                }
+                else
+                {
+                    k -= 2;
+                    std::swap(b.at(k + 1, c), b.at((size_t) (-piv[k] - 1), c));
+                }
+            }
+        }
+    }
+
+    /**
+    * Residual update r -= A x for all the columns of x, with A symmetric
+    * (the lower triangle is referenced).
+    *
+    * @param a Symmetric matrix.
+    * @param n Size of the leading block of a, x and r.
+    * @param x Solutions.
+    * @param r Right hand sides; overwritten by the residuals.
+    */
+    template <typename MatType, typename XType, typename RType>
+    void symmetric_residual(const MatType& a, size_t n, const XType& x,
+        RType& r)
+    {
+        for (size_t c = 0; c < x.n_cols; c++)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                // Diagonal and lower triangle of column j, and its mirror
+                double x_j = x.at(j, c);
+                double dot = 0.0;
+
+                r.at(j, c) -= a.at(j, j) * x_j;
+
+                for (size_t i = j + 1; i < n; i++)
+                {
+                    r.at(i, c) -= a.at(i, j) * x_j;
+                    dot += a.at(i, j) * x.at(i, c);
+                }
+
+                r.at(j, c) -= dot;
+            }
+        }
+    }
+
+    /**
+    * 1-norm (largest absolute column sum) of a symmetric matrix; the lower
+    * triangle of a is referenced.
+    */
+    template <typename MatType>
+    double norm1_symmetric(const MatType& a, size_t n)
+    {
+        double norm = 0.0;
+        for (size_t j = 0; j < n; j++)
+        {
+            // Column j; row j of the lower triangle, then column j
+            double sum = 0.0;
+            for (size_t i = 0; i < j; i++)
+            {
+                sum += std::abs(a.at(j, i));
+            }
+
+            for (size_t i = j; i < n; i++)
+            {
+                sum += std::abs(a.at(i, j));
+            }
+
+            norm = std::max(norm, sum);
+        }
+
+        return norm;
+    }
+
+    /**
+    * Estimates ||A^-1||_1 of a symmetric matrix from its pivoted LDL^T
+    * factors with Hager's method (a lower bound, usually within a factor of
+    * 3). It costs a few solves, i.e. O(n^2) against the O(n^3)
+    * factorisation; the condition number estimate is norm1_symmetric(A)
+    * times the result.
+    *
+    * @param ldl Factors from ldlt_factorise_pivoted.
+    * @param n Size of the factorised block.
+    * @param piv Pivots from ldlt_factorise_pivoted.
+    * @param x, z Scratch vectors of size at least n.
+    */
+    template <typename MatType>
+    double ldlt_inv_norm1_estimate(const MatType& ldl, size_t n,
+        const Pivot* piv, arma::dvec& x, arma::dvec& z)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            x.at(i) = 1.0 / n;
+        }
+
+        double estimate = 0.0;
+        size_t j_prev = n;
+
+        for (size_t iter = 0; iter < 5; iter++)
+        {
+            // y = A^-1 x
+            ldlt_solve_pivoted(ldl, n, piv, x);
+
+            double y_norm = 0.0;
+            for (size_t i = 0; i < n; i++)
+            {
+                y_norm += std::abs(x.at(i));
+            }
+
+            // No further increase
+            if (iter > 0 && y_norm <= estimate)
+            {
+                break;
+            }
+
+            estimate = y_norm;
+
+            // Subgradient z = A^-T sign(y) (A is symmetric)
+            for (size_t i = 0; i < n; i++)
+            {
+                z.at(i) = (x.at(i) >= 0.0) ? 1.0 : -1.0;
+            }
+
+            ldlt_solve_pivoted(ldl, n, piv, z);
+
+            size_t j = 0;
+            for (size_t i = 1; i < n; i++)
+            {
+                if (std::abs(z.at(i)) > std::abs(z.at(j)))
+                {
+                    j = i;
+                }
+            }
+
+            // Converged on a vertex of the unit ball
+            if (j == j_prev)
+            {
+                break;
+            }
+
+            // Next vector; unit vector e_j
+            j_prev = j;
+            for (size_t i = 0; i < n; i++)
+            {
+                x.at(i) = 0.0;
+            }
+            x.at(j) = 1.0;
+        }
+
+        return estimate;
+    }
+
+    /**
+    * LDL^T factorisation (no pivoting) of W symmetric n x n matrices in
+    * lockstep. The matrices are interleaved: entry (i, j) of matrix b is
+    * a[(j * n + i) * W + b], so the inner loops run across the matrices and
+    * vectorise. A matrix with a zero or non finite pivot, or with element
+    * growth above growth_limit (see ldlt_factorise), is marked as failed
+    * (its factors are then meaningless) without stopping the others; it is
+    * left to the caller to factorise it with pivoting. In single precision
+    * (S = float) twice the matrices fit a vector register.
+    *
+    * @param a Interleaved matrices; overwritten by the factors.
+    * @param n Size of the matrices.
+    * @param ok Output; false for the matrices that failed.
+    */
+    template <size_t W, typename S>
+    void ldlt_factorise_lockstep(S* a, size_t n, bool* ok)
+    {
+        // Scale for the pivot and growth tests
+        S scale[W] = {}, tol[W], growth[W];
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t i = j; i < n; i++)
+            {
+                const S* a_ij = a + (j * n + i) * W;
+
+                for (size_t b = 0; b < W; b++)
+                {
+                    scale[b] = std::max(scale[b], std::abs(a_ij[b]));
+                }
+            }
+        }
+
+        for (size_t b = 0; b < W; b++)
+        {
+            tol[b] = n * std::numeric_limits<S>::epsilon() * scale[b];
+            growth[b] = (S) growth_limit * scale[b];
+            ok[b] = true;
+        }
+
+        // Right looking elimination (column oriented)
+        for (size_t j = 0; j < n; j++)
+        {
+            S* a_jj = a + (j * n + j) * W;
+
+            // Largest entries of column j below the diagonal
+            S colmax[W] = {};
+            for (size_t i = j + 1; i < n; i++)
+            {
+                const S* a_ij = a + (j * n + i) * W;
+
+                #pragma omp simd
+                for (size_t b = 0; b < W; b++)
+                {
+                    colmax[b] = std::max(colmax[b], std::abs(a_ij[b]));
+                }
+            }
+
+            // Failed matrices continue with a unit pivot
+            for (size_t b = 0; b < W; b++)
+            {
+                if (!std::isfinite(a_jj[b]) || std::abs(a_jj[b]) <= tol[b] ||
+                    colmax[b] * colmax[b] > growth[b] * std::abs(a_jj[b]))
+                {
+                    ok[b] = false;
+                    a_jj[b] = 1.0;
+                }
+            }
+
+            // Update the trailing lower triangle
+            for (size_t k = j + 1; k < n; k++)
+            {
+                S f[W];
+                const S* a_kj = a + (j * n + k) * W;
+
+                #pragma omp simd
+                for (size_t b = 0; b < W; b++)
+                {
+                    f[b] = a_kj[b] / a_jj[b];
+                }
+
+                for (size_t i = k; i < n; i++)
+                {
+                    S* a_ik = a + (k * n + i) * W;
+                    const S* a_ij = a + (j * n + i) * W;
+
+                    #pragma omp simd
+                    for (size_t b = 0; b < W; b++)
+                    {
+                        a_ik[b] -= a_ij[b] * f[b];
+                    }
+                }
+            }
+
+            // Column j of L
+            for (size_t i = j + 1; i < n; i++)
+            {
+                S* a_ij = a + (j * n + i) * W;
+
+                #pragma omp simd
+                for (size_t b = 0; b < W; b++)
+                {
+                    a_ij[b] /= a_jj[b];
+                }
+            }
+        }
+    }
+
+    /**
+    * Solves the W interleaved systems L D L^T x = b in place (in the
+    * precision of b).
+    *
+    * @param ldl Interleaved factors from ldlt_factorise_lockstep.
+    * @param n Size of the matrices.
+    * @param b Interleaved right hand sides; entry (i, c) of system s is
+    * b[(c * n + i) * W + s]. Overwritten by the solutions.
+    * @param nrhs Number of right hand sides per system.
+    */
+    template <size_t W, typename S, typename B>
+    void ldlt_solve_lockstep(const S* ldl, size_t n, B* b, size_t nrhs)
+    {
+        for (size_t c = 0; c < nrhs; c++)
+        {
+            B* b_c = b + c * n * W;
+
+            // Forward substitution; L y = b
+            for (size_t j = 0; j < n; j++)
+            {
+                const B* y = b_c + j * W;
+
+                for (size_t i = j + 1; i < n; i++)
+                {
+                    B* b_i = b_c + i * W;
+                    const S* l_ij = ldl + (j * n + i) * W;
+
+                    #pragma omp simd
+                    for (size_t s = 0; s < W; s++)
+                    {
+                        b_i[s] -= l_ij[s] * y[s];
+                    }
+                }
+            }
+
+            // Diagonal; D z = y
+            for (size_t j = 0; j < n; j++)
+            {
+                B* b_j = b_c + j * W;
+                const S* d_j = ldl + (j * n + j) * W;
+
+                #pragma omp simd
+                for (size_t s = 0; s < W; s++)
+                {
+                    b_j[s] /= d_j[s];
+                }
+            }
+
+            // Backward substitution; L^T x = z
+            for (size_t j = n; j-- > 0;)
+            {
+                B* b_j = b_c + j * W;
+
+                for (size_t i = j + 1; i < n; i++)
+                {
+                    const B* b_i = b_c + i * W;
+                    const S* l_ij = ldl + (j * n + i) * W;
+
+                    #pragma omp simd
+                    for (size_t s = 0; s < W; s++)
+                    {
+                        b_j[s] -= l_ij[s] * b_i[s];
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+    * Residual update r -= A x of the W interleaved systems (layouts of
+    * ldlt_factorise_lockstep and ldlt_solve_lockstep; A is referenced in
+    * full).
+    *
+    * @param a Interleaved matrices.
+    * @param n Size of the matrices.
+    * @param x Interleaved solutions.
+    * @param r Interleaved right hand sides; overwritten by the residuals.
+    * @param nrhs Number of right hand sides per system.
+    */
+    template <size_t W>
+    void residual_lockstep(const double* a, size_t n, const double* x,
+        double* r, size_t nrhs)
+    {
+        for (size_t c = 0; c < nrhs; c++)
+        {
+            const double* x_c = x + c * n * W;
+            double* r_c = r + c * n * W;
+
+            for (size_t j = 0; j < n; j++)
+            {
+                const double* x_j = x_c + j * W;
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    double* r_i = r_c + i * W;
+                    const double* a_ij = a + (j * n + i) * W;
+
+                    #pragma omp simd
+                    for (size_t s = 0; s < W; s++)
+                    {
+                        r_i[s] -= a_ij[s] * x_j[s];
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <armadillo>
+
+#include "geom.h"
+#include "dense_kernels.h"
+
+/* Cache of pivoted LDL^T factors of moment matrices Gs, in double precision,
+or in single precision together with Gs for the mixed precision refinement
+(see ShapeFunction::set_mixed_precision). Two kinds of keys are supported:
+- The (sorted) indices of the support nodes. The factors only depend on the
+  support coordinates, so these entries are stale once the nodes move.
+- The shape of the support domain, i.e. the support coordinates relative to
+  a local origin. Translated copies of a stencil share these entries.
+The number of entries is bounded; once full, the least recently used entry is
+replaced. The entries and their buffers are allocated once and reused, so a
+warm cache inserts and clears without allocating. */
+class FactorisationCache
+{
+public:
+    // Default number of cached factorisations
+    static constexpr size_t default_capacity = 64;
+
+    FactorisationCache(size_t capacity = default_capacity) {
+        set_capacity(capacity); }
+
+    // Cache statistics (accumulated over the lifetime of the cache)
+    struct Stats {
+        // Number of lookups
+        size_t lookups = 0;
+
+        // Number of lookups that found the factors
+        size_t hits = 0;
+
+        // Number of entries replaced to make room
+        size_t evictions = 0;
+
+        // Hit rate (0 if no lookups)
+        double hit_rate(void) const {
+            return lookups ? (double) hits / (double) lookups : 0.0; }
+    };
+
+    // Cached factorisation
+    struct Factors {
+        // LDL^T factors (n x n, column major; empty if in single precision)
+        std::vector<double> ldl;
+
+        // Single precision LDL^T factors and Gs (n x n, column major)
+        std::vector<float> ldl_float;
+        std::vector<double> gs;
+
+        // Pivots (see dense::ldlt_factorise_pivoted)
+        std::vector<dense::Pivot> piv;
+
+        // Size of the factorised system
+        size_t n = 0;
+
+        // Condition number estimate of Gs (0 if not estimated)
+        double cond = 0.0;
+
+        // Single precision factors (refined against gs)
+        bool mixed(void) const { return !ldl_float.empty(); }
+
+        // Views read by the dense kernels
+        dense::MatrixView<double> ldl_view(void) const { return {ldl.data(), n}; }
+        dense::MatrixView<float> ldl_float_view(void) const {
+            return {ldl_float.data(), n}; }
+        dense::MatrixView<double> gs_view(void) const { return {gs.data(), n}; }
+    };
+
+    /**
+    * Finds the factors of a support set. The factors are valid until the
+    * next insertion.
+    *
+    * @param indices Sorted indices of the support nodes.
+    * @param ns Number of support nodes.
+    * @return Factors, or nullptr if the support set is not cached.
+    */
+    const Factors* find(const size_t* indices, size_t ns);
+
+    /**
+    * Stores the factors of a support set.
+    *
+    * @param indices Sorted indices of the support nodes.
+    * @param ns Number of support nodes.
+    * @param ldl Factors; only the leading n x n block is stored.
+    * @param piv Pivots of the factors (size n).
+    * @param n Size of the factorised system.
+    * @param cond Condition number estimate of Gs (0 if not estimated).
+    */
+    void insert(const size_t* indices, size_t ns, const arma::dmat& ldl,
+        const dense::Pivot* piv, size_t n, double cond = 0.0);
+
+    /**
+    * Stores the single precision factors of a support set.
+    *
+    * @param indices Sorted indices of the support nodes.
+    * @param ns Number of support nodes.
+    * @param ldl_float Factors; only the leading n x n block is stored.
+    * @param gs Gs matrix of the refinement (leading n x n block).
+    * @param piv Pivots of the factors (size n).
+    * @param n Size of the factorised system.
+    */
+    void insert(const size_t* indices, size_t ns, const arma::fmat& ldl_float,
+        const arma::dmat& gs, const dense::Pivot* piv, size_t n);
+
+    /**
+    * Finds the factors of a support domain shape. The factors are valid until
+    * the next insertion.
+    *
+    * @param shape Support coordinates relative to the local origin.
+    * @param tol Coordinates tolerance of equal shapes.
+    * @return Factors, or nullptr if the shape is not cached.
+    */
+    const Factors* find(const geom::PointSetView<double>& shape, double tol);
+
+    /**
+    * Stores the factors of a support domain shape.
+    *
+    * @param shape Support coordinates relative to the local origin.
+    * @param ldl Factors; only the leading n x n block is stored.
+    * @param piv Pivots of the factors (size n).
+    * @param n Size of the factorised system.
+    * @param cond Condition number estimate of Gs (0 if not estimated).
+    */
+    void insert(const geom::PointSetView<double>& shape, const arma::dmat& ldl,
+        const dense::Pivot* piv, size_t n, double cond = 0.0);
+
+    /**
+    * Stores the single precision factors of a support domain shape.
+    *
+    * @param shape Support coordinates relative to the local origin.
+    * @param ldl_float Factors; only the leading n x n block is stored.
+    * @param gs Gs matrix of the refinement (leading n x n block).
+    * @param piv Pivots of the factors (size n).
+    * @param n Size of the factorised system.
+    */
+    void insert(const geom::PointSetView<double>& shape,
+        const arma::fmat& ldl_float, const arma::dmat& gs, const dense::Pivot* piv,
+        size_t n);
+
+    /**
+    * Replaces the coordinates of a support domain shape by those of an equal
+    * cached shape, so that the right hand sides are evaluated on the
+    * geometry of the cached factors (not counted as a lookup).
+    *
+    * @param x, y Support coordinates relative to the local origin.
+    * @param n Number of support nodes.
+    * @param tol Coordinates tolerance of equal shapes.
+    * @return True if an equal shape is cached.
+    */
+    bool snap(double* x, double* y, size_t n, double tol) const;
+
+    /* Set the cell of the shape hash (e.g. a fraction of the nodal spacing).
+    It must be much larger than the tolerances of the shapes, so that equal
+    shapes rarely fall on both sides of a cell boundary, and it must not
+    change while shapes are cached. */
+    void set_shape_cell(double shape_cell) { m_shape_cell = shape_cell; }
+
+    // Set the maximum number of cached factorisations (clears the cache)
+    void set_capacity(size_t capacity);
+
+    // Get the maximum number of cached factorisations
+    size_t get_capacity(void) const { return m_entries.size(); }
+
+    // Remove all the factors (statistics and storage are kept)
+    void clear(void);
+
+    /* Remove the factors of support sets, which are stale once the nodes move;
+    the shape entries only depend on relative coordinates and are kept */
+    void clear_supports(void);
+
+    // Number of cached support sets and shapes
+    size_t size(void) const;
+
+    // Get statistics
+    const Stats& get_stats(void) const { return m_stats; }
+
+private:
+    // Kind of key of an entry
+    enum class Key : unsigned char { NONE, SUPPORT, SHAPE };
+
+    // Key of an entry (scanned by the lookups)
+    struct Slot {
+        // Hash of the key
+        size_t hash = 0;
+
+        // Kind of key (NONE: free entry)
+        Key key = Key::NONE;
+
+        // Last use (least recently used entries are replaced first)
+        size_t last_use = 0;
+    };
+
+    // Cached factors of a support set or a support domain shape
+    struct Entry {
+        // Support nodes indices (support set key)
+        std::vector<size_t> indices;
+
+        // Relative support coordinates (shape key)
+        std::vector<double> x, y;
+
+        // Factorisation
+        Factors factors;
+    };
+
+    // Index of the cached entry of a support domain shape (capacity if none)
+    size_t find_entry(const geom::PointSetView<double>& shape, double tol) const;
+
+    // Entry for a new key: a free one or the least recently used one
+    size_t acquire(size_t h, Key key);
+
+    // Store the leading n x n factors and the pivots into an entry
+    void store(size_t e, const arma::dmat& ldl, const dense::Pivot* piv,
+        size_t n, double cond);
+
+    // Store the leading n x n single precision factors, Gs and the pivots
+    void store(size_t e, const arma::fmat& ldl_float, const arma::dmat& gs,
+        const dense::Pivot* piv, size_t n);
+
+    // Copy the leading n x n block of a matrix into a flat buffer
+    template <typename S>
+    static void copy_block(const arma::Mat<S>& a, size_t n, std::vector<S>& v);
+
+    // Hash of a support set
+    static size_t hash(const size_t* indices, size_t ns);
+
+    // Hash of a support domain shape (coordinates quantised by the shape cell)
+    size_t hash(const geom::PointSetView<double>& shape) const;
+
+    // Keys and entries (capacity of the cache)
+    std::vector<Slot> m_slots;
+    std::vector<Entry> m_entries;
+
+    // Use counter
+    size_t m_clock = 0;
+
+    // Cell of the shape hash
+    double m_shape_cell = 1.0e-6;
+
+    // Statistics
+    Stats m_stats;
+};
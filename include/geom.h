@@ -2,6 +2,10 @@
 
 #include <iostream>
 #include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include "aligned_allocator.h"
 
 namespace geom {
 
@@ -39,6 +43,9 @@ namespace geom {
     {
         // Initialize point cloud vec
         PointCloudVec<T> pc_vec;
+        pc_vec.x.reserve(pc.pts.size());
+        pc_vec.y.reserve(pc.pts.size());
+        pc_vec.z.reserve(pc.pts.size());
 
         for(size_t i = 0; i < pc.pts.size(); i++)
         {
@@ -50,6 +57,132 @@ namespace geom {
         return pc_vec;
     }
 
+    // Non-owning view over contiguous x, y, z arrays (nanoflann adaptor)
+    template <typename T>
+    struct PointSetView
+    {
+        /* Coordinates arrays. z is null for planar point sets (e.g. the
+        support domains of the shape functions); their z coordinate then
+        reads as 0 through point and kdtree_get_pt. */
+        const T *x, *y, *z;
+
+        // Number of points
+        size_t n;
+
+        // Number of points
+        inline size_t size(void) const { return n; }
+
+        // Planar point set (no z array)
+        inline bool planar(void) const { return z == nullptr; }
+
+        // Get z coordinate of point idx (0 for planar point sets)
+        inline T get_z(size_t idx) const { return z != nullptr ? z[idx] : T(0); }
+
+        // Get point idx
+        inline Point<T> point(size_t idx) const { return {x[idx], y[idx], get_z(idx)}; }
+
+        // Must return the number of data points
+        inline size_t kdtree_get_point_count() const { return n; }
+
+        // Returns the dim'th component of the idx'th point
+        inline T kdtree_get_pt(const size_t idx, const size_t dim) const
+        {
+            if (dim == 0) return x[idx];
+            else if (dim == 1) return y[idx];
+            else return get_z(idx);
+        }
+
+        // Default to the standard bbox computation loop
+        template <class BBOX>
+        bool kdtree_get_bbox(BBOX& /* bb */) const { return false; }
+    };
+
+    // Structure-of-arrays point cloud (contiguous aligned coordinate arrays)
+    template <typename T>
+    struct PointCloudSoA
+    {
+        // Coordinates containers
+        std::vector<T, AlignedAllocator<T>> x, y, z;
+
+        // Number of points
+        inline size_t size(void) const { return x.size(); }
+
+        // Reserve memory for n points
+        void reserve(size_t n) { x.reserve(n); y.reserve(n); z.reserve(n); }
+
+        // Resize to n points
+        void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); }
+
+        // Remove all points
+        void clear(void) { x.clear(); y.clear(); z.clear(); }
+
+        // Append point (converted to the cloud scalar type)
+        template <typename U>
+        void push_back(const Point<U>& pt)
+        {
+            x.push_back(static_cast<T>(pt.x));
+            y.push_back(static_cast<T>(pt.y));
+            z.push_back(static_cast<T>(pt.z));
+        }
+
+        // Append point cloud
+        void append(const PointCloudSoA<T>& pc)
+        {
+            x.insert(x.end(), pc.x.begin(), pc.x.end());
+            y.insert(y.end(), pc.y.begin(), pc.y.end());
+            z.insert(z.end(), pc.z.begin(), pc.z.end());
+        }
+
+        // Append point cloud (array of structures)
+        template <typename U>
+        void append(const PointCloud<U>& pc)
+        {
+            reserve(size() + pc.pts.size());
+            for (const auto& pt : pc.pts) { push_back(pt); }
+        }
+
+        // Get point idx
+        inline Point<T> point(size_t idx) const { return {x[idx], y[idx], z[idx]}; }
+
+        // View of the whole cloud
+        PointSetView<T> view(void) const
+        {
+            return {x.data(), y.data(), z.data(), x.size()};
+        }
+
+        // View of count points starting from offset
+        PointSetView<T> view(size_t offset, size_t count) const
+        {
+            return {x.data() + offset, y.data() + offset, z.data() + offset, count};
+        }
+
+        // Must return the number of data points
+        inline size_t kdtree_get_point_count() const { return x.size(); }
+
+        // Returns the dim'th component of the idx'th point
+        inline T kdtree_get_pt(const size_t idx, const size_t dim) const
+        {
+            if (dim == 0) return x[idx];
+            else if (dim == 1) return y[idx];
+            else return z[idx];
+        }
+
+        // Default to the standard bbox computation loop
+        template <class BBOX>
+        bool kdtree_get_bbox(BBOX& /* bb */) const { return false; }
+    };
+
+    // Convert PointCloud to PointCloudSoA
+    template <typename T>
+    PointCloudSoA<T> conv_pc_to_pc_soa(const PointCloud<T>& pc)
+    {
+        // Initialize point cloud soa
+        PointCloudSoA<T> pc_soa;
+        pc_soa.append(pc);
+
+        return pc_soa;
+    }
+
     // Triangular 2D element struct
     struct Triangular2DElement
     {
@@ -65,6 +198,13 @@ namespace geom {
         int node2_index;
     };
 
+    // Thread-parallel assembly over the quadrature points
+    enum class AssemblyStrategy {
+        // Thread local contributions, merged at the end
+        THREAD_BUFFERS,
+        // Points coloured so that concurrent points share no support node
+        COLOURING };
+
     // RPIM parameters 
     struct RPIMParameters{
 
@@ -82,6 +222,42 @@ namespace geom {
 
         // Support domain constant
         double as;
+
+        // Shape constant of the radial basis (0: the support domain constant)
+        double ac = 0.0;
+
+        /* Size of the polynomial basis of the shape functions; 0 (none), 3
+        (linear) or 6 (quadratic, needs at least 6 nodes per support domain) */
+        int ms = 0;
+
+        /* Evaluate the shape functions in local coordinates and share the Gs
+        factorisation between translated support domains (structured grids) */
+        bool local_stencils = false;
+
+        /* Gs factorisations cached per thread (support sets and stencil
+        shapes); the least recently used ones are replaced */
+        size_t factorisation_cache_capacity = 64;
+
+        /* Factorise the Gs systems in single precision with double precision
+        refinement (see ShapeFunction::set_mixed_precision); both the batched
+        precompute of the shape functions and the per point updates, whose
+        cached factors are then kept in single precision with Gs */
+        bool mixed_precision = false;
+
+        /* Total Lagrangian (or small strain) formulation: the support domains
+        and shape functions are evaluated once in the reference configuration
+        and reused on every update */
+        bool total_lagrangian = false;
+
+        /* Tune the shape constant ac once in the reference configuration, so
+        that the Gs condition estimates stay below max_condition */
+        bool tune_shape_constant = false;
+
+        // Conditioning bound of the shape constant tuning
+        double max_condition = 1.0e12;
+
+        // Parallel assembly of the stiffness and external forces
+        AssemblyStrategy assembly = AssemblyStrategy::THREAD_BUFFERS;
     };
 
     // Get indices of sorted array
@@ -5,15 +5,36 @@
 #include <vector>
 #include "./support_domain.h"
 #include "./shape_function.h"
+#include "./mls_shape_function.h"
 #include "./strain.h"
+#include "./stiffness_kernels.h"
 #include "./material.h"
 #include "./loading_conditions.h"
 
 
+/* T: coordinates scalar type of the support domains (float or double)
+Dim: spatial dimension; Dofs: field components per node (Dim for displacement
+fields, 1 for scalar fields such as temperature). The global dof of component
+c of node i is Dofs*i + c.
+ShapeFn: shape function construction (e.g. ShapeFunction<rbf::WendlandC2>, or
+MLSShapeFunction for large runs). */
+template <typename T, size_t Dim = 2, size_t Dofs = 2,
+    typename ShapeFn = ShapeFunction<>>
 class GeometryModel
 {
+    static_assert(Dim == ShapeFn::dim, "The support domains are two "
+        "dimensional");
+
 public:
-    GeometryModel(const std::vector<SupportDomain::SupportDomainPoint>& sd_pts,
+    // Dofs per node
+    static constexpr size_t dofs_per_node = Dofs;
+
+    // Number of strain components
+    static constexpr size_t strain_size = Strain<Dim, Dofs>::strain_size;
+
+    // The support domain table is referenced (not copied); it must outlive
+    // the model
+    GeometryModel(const typename SupportDomain<T>::SupportDomainTable& sd_table,
         const geom::RPIMParameters& rpim_params);
 
     /**
@@ -21,34 +42,98 @@ public:
     * deformation and jacobians du/dq_bar and depsilon/dq_bar
     *
     * @param idx The idx of the point in which the deformation is evaluated 
-    * x_idx = m_sd_pts.at(idx).point_coords. The function is evaluated to discrete 
+    * x_idx = m_sd_table->at(idx) point coordinates. The function is evaluated to discrete 
     * x values (defined by idx). It can't be used for any x.
     * @param q_bar The global vector of deformations.
     */
     void update(size_t idx, const arma::dvec& q_bar, double tol=1.0e-5);
 
+    /**
+    * Calculates the shape functions of all the points of the support domain
+    * table at once (batched, lockstep factorisations) into a flat table.
+    * Update then gathers them until the table is regenerated; in a Total
+    * Lagrangian analysis (reference configuration table) they are computed
+    * once.
+    */
+    void precompute_shape_functions(void);
+
+    /**
+    * Gathers the shape functions from the precomputed table of another model
+    * of the same support domain table (read only; e.g. one model per thread).
+    *
+    * @param owner Model holding the table; it must outlive this one.
+    */
+    void share_shape_functions(const GeometryModel& owner) { m_phis_owner = &owner; }
+
+    // Set the shape constant ac of the model (drops the precomputed table)
+    void set_shape_constant(double ac) {
+        m_sf_s.set_shape_constant(ac); m_phis_table.resize(0); }
+
     // Get strain 
-    arma::dvec get_strain(void) { return m_strain; }
+    const arma::dvec& get_strain(void) const { return m_strain_s.get_strain_vector(); }
 
     // Get deformation
-    arma::dvec get_deformation(void) { return m_deformation; }
+    const arma::dvec& get_deformation(void) const { return m_deformation; }
     
-    // Get strain jacobian
-    arma::dmat get_strain_jacobian(void) { return m_strain_jac; }
+    /* Strain jacobian depsilon/dq_bar (dense, assembled on demand; the force
+    and stiffness functions apply Ds implicitly) */
+    arma::dmat get_strain_jacobian(void) const;
+
+    /* Deformation jacobian du/dq_bar = [phi_1 I, ..., phi_ns I] scattered to
+    the global dofs (dense, assembled on demand) */
+    arma::dmat get_deformation_jacobian(void) const;
 
-    // Get deformation jacobian
-    arma::dmat get_deformation_jacobian(void) { return m_deformation_jac; } 
+    /* Global dofs of the local (support domain) dofs of the last update; the
+    local dof Dofs*i + c is component c of support node i */
+    const std::vector<size_t>& get_local_dofs(void) const { return m_local_dofs; }
 
     // Get x interest
-    arma::dvec get_x_interest(void) { return m_x_inter; }
+    const arma::dvec& get_x_interest(void) const { return m_x_inter; }
 
-    // Get Ds matrix    
-    arma::dmat get_ds_matrix(void) { return m_ds_matrix; }
+    // Get Ds matrix (assembled on demand)
+    arma::dmat get_ds_matrix(void) const { return m_strain_s.get_ds_matrix(); }
 
-    // Get elasticity matrix
-    arma::dmat get_elasticity_matrix(void) { return m_c_mat; }
+    // Get constitutive (elasticity) matrix
+    const arma::dmat& get_elasticity_matrix(void) const { return m_c_mat; }
+
+    // Get Gs factorisation cache statistics (hit rate over support sets)
+    const FactorisationCache::Stats& get_factorisation_cache_stats(void) const {
+        return m_sf_s.get_cache_stats(); }
 
 public:
+    /* Local contributions of the support domain of the last update, on the
+    dofs of get_local_dofs. Their cost is independent of the model size;
+    they are scattered (added) to the global vectors and matrices. The
+    returned references are valid until the next call. */
+
+    // Calculate local f_el
+    const arma::dvec& f_el_local(const arma::dvec& x, const arma::dvec& q_bar);
+
+    // Calculate local fbex
+    const arma::dvec& f_bex_local(const arma::dvec& x, const arma::dvec& q_bar);
+
+    // Calculate local ftex
+    const arma::dvec& f_tex_local(const arma::dvec& x, const arma::dvec& q_bar);
+
+    // Calculate local stifness matrix
+    const arma::dmat& k_el_local(const arma::dvec& x, const arma::dvec& q_bar);
+
+    /**
+    * Adds the weighted local stiffness of the last update to the block values
+    * of block sparse matrices (see BSRMatrix::add_local). Plane elasticity
+    * without shear coupling uses the fused kernel (the local matrix is not
+    * formed); otherwise k_el_local is scattered by node blocks.
+    *
+    * @param weight Integration weight.
+    * @param slots Block slot of each support node pair (i, j), at j * ns + i.
+    * @param values Block values the slots refer to.
+    */
+    void add_k_el_local(double weight, const BSRMatrix::Index* slots,
+        double* values);
+
+    /* Global contributions (the local ones scattered into zeroed global
+    vectors and matrices of the size of q_bar) */
+
     // Calculate f_el function
     arma::dvec f_el_function(const arma::dvec& x, const arma::dvec& q_bar);
 
@@ -63,49 +148,84 @@ public:
 
 private:
 
-    // Support domain points structure
-    std::vector<SupportDomain::SupportDomainPoint> m_sd_pts;
+    // Support domain table
+    const typename SupportDomain<T>::SupportDomainTable* m_sd_table;
+
+    // Version of the support domain table the cached factors belong to
+    size_t m_sd_table_version;
     
     // Support domain radius 
     geom::RPIMParameters m_search_params;
 
 private:
     /**
-    * Calculates the mapping from global to local coordinates
+    * Calculates the global dofs of the local (support domain) dofs.
     *
     * @param sup_dom_s Support domain structure for the "s" domain
-    * @param q_bar_size The size of the global vector of deformations.
-    * @return Local (to the support domain) mapping matrix
+    * @param local_dofs Output global dof of each local dof (size Dofs * ns).
     */
-    arma::umat global_to_local_mapping_matrix(const
-        SupportDomain::SupportDomainPoint& sup_dom_s, size_t q_bar_size);
+    void local_to_global_dofs(const
+        typename SupportDomain<T>::SupportDomainPoint& sup_dom_s,
+        std::vector<size_t>& local_dofs) const;
+
+    // Scatters a local vector to a zeroed global vector of size n
+    arma::dvec scatter_vector(const arma::dvec& local, size_t n) const;
+
+    // Calculates the shape functions of the table points into the table
+    void precompute_points(const std::vector<size_t>& points);
+
+    /* Applies the transposed shape function operator [phi_1 I, ..., phi_ns I]^T
+    to v (size Dofs); written into out (size Dofs * ns) */
+    void apply_phis_transpose(const arma::dvec& v, arma::dvec& out) const;
 
 private:
 
-    // // Shape function constants
-    double m_sf_ms = 0.0;
+    /* Shape function, its measures and the strain model of the support
+    domain s. They are kept between updates so their matrices are reused;
+    each thread evaluating the model needs its own GeometryModel. */
+    ShapeFn m_sf_s;
 
-    // Deformation vector
-    arma::dvec m_deformation;
+    // Shape function measures
+    shape::Measures m_phis_s;
+
+    // Precomputed shape function measures of the table points
+    shape::MeasuresTable m_phis_table;
+
+    // Measures of a chunk of points (precompute workspace)
+    std::vector<shape::Measures> m_phis_chunk;
+
+    // Version of the support domain table the precomputed measures belong to
+    size_t m_phis_table_version;
 
-    // Strain vector
-    arma::dvec m_strain;
+    // Model holding the precomputed measures (nullptr: this one)
+    const GeometryModel* m_phis_owner = nullptr;
 
-    // Deformation jacobian
-    arma::dmat m_deformation_jac;
+    // Strain model
+    Strain<Dim, Dofs> m_strain_s;
 
-    // Strain jacobian
-    arma::dmat m_strain_jac;
+    // Local nodal deformations
+    arma::dvec m_es;
+
+    // Deformation vector
+    arma::vec::fixed<Dofs> m_deformation;
+
+    // Local force vector and stiffness matrix (memory reused between calls)
+    arma::dvec m_f_local;
+    arma::dmat m_k_local;
 
     // x interest 
-    arma::dvec m_x_inter;
+    arma::vec::fixed<Dim> m_x_inter;
+
+    // Constitutive (elasticity or conductivity) matrix
+    arma::mat::fixed<strain_size, strain_size> m_c_mat;
 
-    // Elasticity matrix
-    arma::dmat m_c_mat;
+    // Constants of the fused stiffness kernel (plane elasticity only)
+    stiffness::PlaneConstants m_plane_constants;
+    bool m_fused_stiffness = false;
 
-    // Mapping matrix
-    arma::umat m_ls_mat;
+    // Global dofs of the local dofs (gather and scatter indices)
+    std::vector<size_t> m_local_dofs;
 
-    // Ds matrix   
-    arma::dmat m_ds_matrix;
+    // Number of global dofs of the last update
+    size_t m_global_dofs_num = 0;
 };
\ No newline at end of file
@@ -15,8 +15,9 @@ public:
     // Constructor
     GQLineRPIM();
 
-    // Generate quadrature points 
-    geom::PointCloud<double> generate_quadrature_points(const Mesh2D& mesh,
+    // Generate quadrature points (T: coordinates scalar type)
+    template <typename T = double>
+    geom::PointCloudSoA<T> generate_quadrature_points(const Mesh2D& mesh,
         int evals=4);
 
     // Quadrature points per element
@@ -33,10 +34,10 @@ public:
     };
 
     // Get cell properties
-    std::vector<CellProperties> get_integration_cells_properties(void);
+    const std::vector<CellProperties>& get_integration_cells_properties(void) const;
 
     // Get quadrature weights
-    std::vector<double> get_quadrature_weights(void) { return m_weights; }
+    const std::vector<double>& get_quadrature_weights(void) const { return m_weights; }
 
 private:
     // Weights for given order
@@ -51,9 +52,6 @@ private:
     // Weights and points generation
     void weight_point_generation(void);
 
-    //Quadrature points (x elements - y quadrature points)
-    std::vector<std::vector<arma::dvec>> m_quadrature_pts;
-
     // Elements number
     size_t m_elements_num;
 
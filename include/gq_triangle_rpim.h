@@ -22,8 +22,9 @@ public:
     // Constructor
     GQTriangleRPIM();
 
-    // Generate quadrature points 
-    geom::PointCloud<double> generate_quadrature_points(const
+    // Generate quadrature points (T: coordinates scalar type)
+    template <typename T = double>
+    geom::PointCloudSoA<T> generate_quadrature_points(const
         Mesh2D& mesh, int order = LINEAR);
 
     // Quadrature points per element
@@ -40,10 +41,10 @@ public:
     };
 
     // Get cell properties
-    std::vector<CellProperties> get_integration_cells_properties(void);
+    const std::vector<CellProperties>& get_integration_cells_properties(void) const;
 
     // Get quadrature weights
-    std::vector<double> get_quadrature_weights(void) { return m_weights;}
+    const std::vector<double>& get_quadrature_weights(void) const { return m_weights;}
 
 private:
 
@@ -64,9 +65,6 @@ private:
     // Weights and points generation
     void weight_point_generation(void);
 
-    //Quadrature points (x elements - y quadrature points)
-    std::vector<std::vector<arma::dvec>> m_quadrature_pts;
-
     // Weighs and points
     WeightPoint m_wps;
 
@@ -3,56 +3,48 @@
 #include <iostream>
 #include <armadillo>
 #include <vector>
+#include <memory>
 #include "nanoflann.hpp"
 #include "geom.h"
 
+// T: coordinates scalar type (float or double)
+template <typename T>
 class KDTrees
 {
     public:
-        KDTrees(const geom::PointCloud<double> interest_points,
-    		const geom::PointCloud<double> dataset);
-        
-        // // Nearest neighbour search
-        // std::vector<std::vector<int>> nn_search(int nn_number,
-        //     const geom::PointCloud<double> interest_points,
-        //     const geom::PointCloud<double> dataset);
+        /**
+        * Builds the kd tree index over the dataset. The dataset is accessed
+        * through a view (no copy); the underlying cloud must outlive the tree.
+        */
+        KDTrees(const geom::PointSetView<T>& dataset);
 
-        // Nearest neighbour search
-        std::vector<int> radius_search(int query_pt_idx, double search_radius);
+        // The index refers to m_kd_dataset: no copy or move
+        KDTrees(const KDTrees&) = delete;
+        KDTrees& operator=(const KDTrees&) = delete;
+        KDTrees(KDTrees&&) = delete;
+        KDTrees& operator=(KDTrees&&) = delete;
+
+        // Search matches (index, distance)
+        typedef std::vector<std::pair<size_t, T>> Matches;
+
+        // Radius search around query point
+        std::vector<int> radius_search(const geom::Point<T>& query_pt,
+            T search_radius) const;
+
+        // Radius search around query point (unordered; reuses the container)
+        size_t radius_search(const geom::Point<T>& query_pt,
+            T search_radius, Matches& matches) const;
 
     private:
 
-        // KDPointCloud struct
-        struct KDPointCloud
-        {
-            // Pts container
-	        std::vector<geom::Point<double>> pts;
-
-	        // Must return the number of data points
-	        inline size_t kdtree_get_point_count() const { return pts.size(); }
-
-	        // Returns the dim'th component of the idx'th point in the class:
-	        // Since this is inlined and the "dim" argument is typically an immediate value, the
-	        //  "if/else's" are actually solved at compile time.
-	        inline double kdtree_get_pt(const size_t idx, const size_t dim) const
-	        {
-		        if (dim == 0) return pts[idx].x;
-		        else if (dim == 1) return pts[idx].y;
-		        else return pts[idx].z;
-	        }
-
-	        // Optional bounding-box computation: return false to default to a standard bbox computation loop.
-	        //   Return true if the BBOX was already computed by the class and returned in "bb" so it can be avoided to redo it again.
-	        //   Look at bb.size() to find out the expected dimensionality (e.g. 2 or 3 for point clouds)
-	        template <class BBOX>
-	        bool kdtree_get_bbox(BBOX& /* bb */) const { return false; }
-        };
-    
         // Support domain typedef
 	    typedef nanoflann::KDTreeSingleIndexAdaptor<
-		    nanoflann::L1_Adaptor<double, KDPointCloud>,
-		    KDPointCloud, 3> m_kd_tree;
+		    nanoflann::L1_Adaptor<T, geom::PointSetView<T>>,
+		    geom::PointSetView<T>, 3> m_kd_tree;
+
+		// KD dataset (view over the original cloud)
+		geom::PointSetView<T> m_kd_dataset;
 
-		// KD interest points and dataset
-		KDPointCloud m_kd_interest_points, m_kd_dataset;
-};
\ No newline at end of file
+		// KD index
+		std::unique_ptr<m_kd_tree> m_index;
+};
@@ -5,6 +5,8 @@
 #include <armadillo>
 #include "./geom.h"
 
+// Dofs: number of field components per node (2: forces; 1: heat sources/fluxes)
+template <size_t Dofs>
 class LoadingConditions
 {
     public:
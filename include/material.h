@@ -13,6 +13,14 @@ class Material
 
         static arma::dmat get_elasticity_matrix(void);
 
+        static arma::dmat get_conductivity_matrix(size_t dim);
+
+        /* Constitutive matrix relating the strain measure of a field with
+        Dofs components per node to its flux: elasticity for displacements
+        (Dofs == Dim), conductivity for scalar fields (Dofs == 1) */
+        template <size_t Dim, size_t Dofs>
+        static arma::dmat get_constitutive_matrix(void);
+
     private:
         
 };
\ No newline at end of file
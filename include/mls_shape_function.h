@@ -0,0 +1,113 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <armadillo>
+
+#include "geom.h"
+#include "dense_kernels.h"
+#include "shape_measures.h"
+#include "factorisation_cache.h"
+
+/* Moving least squares shape functions with a linear basis p = [1, x, y] and a
+quartic spline weight of radius ac * dc / 2 (the support domain search
+radius for ac = as). Only the 3 x 3 weighted moment matrix A(x) = sum_i w_i p_i p_i^T is
+factorised, so the cost is linear in the number of support nodes. The shape
+functions do not have the Kronecker delta property; essential boundary
+conditions must be enforced by other means. Every support domain needs three
+non collinear nodes strictly inside the weight radius (as >= 3 on regular
+grids); degenerate supports fall back to a least squares solution.
+
+It has the interface of ShapeFunction, so it can be used as the shape function
+of a GeometryModel. */
+class MLSShapeFunction
+{
+
+public:
+    // Spatial dimension of the support domains
+    static constexpr size_t dim = 2;
+
+    // Size of the (linear) polynomial basis
+    static constexpr size_t basis_size = 3;
+
+    /* The exponent q and the basis order ms of the RPIM shape functions are
+    accepted for interface compatibility (the basis is always linear) */
+    MLSShapeFunction(double ac, double dc, double q, int ms=3);
+
+    // Returns the vector and its jacoban
+    using VecJac = shape::VecJac;
+
+    // Shape function measures
+    using Measures = shape::Measures;
+
+    /**
+    * Calculates the shape function measures at x. The intermediate arrays are
+    * taken from the workspace of this object, so a MLSShapeFunction must not
+    * be shared between threads.
+    *
+    * @param x Interest point.
+    * @param sup_dom Coordinates of the support domain nodes.
+    * @param phis_str Output measures (its memory is reused between calls).
+    * @param support_indices Unused (no factorisation is cached).
+    */
+    template <typename T>
+    void calculate(const arma::dvec& x, const geom::PointSetView<T>& sup_dom,
+        Measures& phis_str, const size_t* support_indices = nullptr);
+
+    /**
+    * Calculates the shape function measures of a group of interest points.
+    *
+    * @param xs, ys Interest points coordinates.
+    * @param sup_doms Support domains of the interest points.
+    * @param count Number of interest points.
+    * @param phis_strs Output measures of the count interest points.
+    */
+    template <typename T>
+    void calculate_batch(const T* xs, const T* ys,
+        const geom::PointSetView<T>* sup_doms, size_t count, Measures* phis_strs);
+
+    // No factorisations are cached
+    void clear_cache(void) {}
+
+    void set_cache_capacity(size_t) {}
+
+    // The basis is always centred at the interest point (see calculate)
+    void set_stencil_reuse(bool) {}
+
+    // Only 3 x 3 systems are solved (always in double precision)
+    void set_mixed_precision(bool) {}
+
+    // Get cache statistics (always empty)
+    const FactorisationCache::Stats& get_cache_stats(void) const {
+        return m_cache_stats; }
+
+    // Set the shape constant ac (weight radius ac * dc / 2)
+    void set_shape_constant(double ac);
+
+    // Get the shape constant ac
+    double get_shape_constant(void) const { return m_ac; }
+
+private:
+    // Shape function constants
+    double m_ac, m_dc;
+
+    // Inverse squared weight radius
+    double m_inv_rw2;
+
+    // Empty cache statistics
+    FactorisationCache::Stats m_cache_stats;
+
+private:
+    /* Scratch memory of calculate (reused between calls). The support nodes
+    are held relative to the interest point and scaled by dc, which keeps the
+    moment matrix well conditioned. */
+    struct Workspace {
+        // Scaled local coordinates of the support nodes
+        std::vector<double> u, v;
+
+        // Weights and their gradients
+        std::vector<double> w, dw_dx, dw_dy;
+    };
+
+    Workspace m_ws;
+};
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/* Batched multiquadric kernels r(x) = (|x - x_s|^2 + c^2)^q over the SoA
+coordinates of a support set. The loops are branch free and annotated for
+SIMD vectorisation (OpenMP simd); the exponent is classified once:
+- Integer and half integer q (e.g. 0.5, 1.5): products and one sqrt.
+- General q (e.g. 1.03): exp(q log d) with vectorisable exp and log. */
+namespace mq {
+
+    // Exponent classes
+    enum class ExponentKind { INTEGER, HALF_INTEGER, GENERAL };
+
+    // Kernel parameters
+    struct Parameters
+    {
+        // Squared shape parameter c^2 = (ac * dc)^2
+        double c2;
+
+        // Exponent
+        double q;
+
+        // Exponent class
+        ExponentKind kind;
+
+        // Integer part of q (integer and half integer exponents)
+        int k;
+    };
+
+    // Classify the exponent
+    inline Parameters make_parameters(double ac, double dc, double q)
+    {
+        Parameters params;
+        params.c2 = (ac * dc) * (ac * dc);
+        params.q = q;
+        params.kind = ExponentKind::GENERAL;
+        params.k = 0;
+
+        // Small non negative integer or half integer exponents only
+        if (q >= 0.0 && q <= 16.0)
+        {
+            double k = std::floor(q);
+
+            if (q == k)
+            {
+                params.kind = ExponentKind::INTEGER;
+                params.k = (int) k;
+            }
+            else if (q - k == 0.5)
+            {
+                params.kind = ExponentKind::HALF_INTEGER;
+                params.k = (int) k;
+            }
+        }
+
+        return params;
+    }
+
+    // Natural logarithm of a positive normal number (about 1 ulp)
+    inline double log_positive(double d)
+    {
+        const double ln2_hi = 6.93147180369123816490e-01;
+        const double ln2_lo = 1.90821492927058770002e-10;
+
+        // d = m 2^e with m in [1, 2); the exponent field is converted to
+        // double through the 2^52 shifter (vectorisable integer operations)
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(double));
+        uint64_t e_bits = (bits >> 52) | 0x4330000000000000ULL;
+        double e;
+        std::memcpy(&e, &e_bits, sizeof(double));
+        e -= 4503599627370496.0 + 1023.0;
+        bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+        double m;
+        std::memcpy(&m, &bits, sizeof(double));
+
+        // Shift m to [sqrt(1/2), sqrt(2))
+        bool big = m > 1.41421356237309504880;
+        m = big ? 0.5 * m : m;
+        e = big ? e + 1.0 : e;
+
+        // log(m) = 2 atanh(s), s = (m - 1) / (m + 1), |s| <= 0.1716
+        double s = (m - 1.0) / (m + 1.0);
+        double s2 = s * s;
+        double p = 1.0 / 19.0;
+        p = p * s2 + 1.0 / 17.0;
+        p = p * s2 + 1.0 / 15.0;
+        p = p * s2 + 1.0 / 13.0;
+        p = p * s2 + 1.0 / 11.0;
+        p = p * s2 + 1.0 / 9.0;
+        p = p * s2 + 1.0 / 7.0;
+        p = p * s2 + 1.0 / 5.0;
+        p = p * s2 + 1.0 / 3.0;
+        p = p * s2 + 1.0;
+
+        return e * ln2_hi + (e * ln2_lo + 2.0 * s * p);
+    }
+
+    // Exponential for |y| < 700 (about 1 ulp)
+    inline double exp_bounded(double y)
+    {
+        const double log2e = 1.44269504088896338700;
+        const double ln2_hi = 6.93147180369123816490e-01;
+        const double ln2_lo = 1.90821492927058770002e-10;
+
+        // y = k ln2 + r, |r| <= ln2 / 2; k is rounded with the 1.5 2^52
+        // shifter, whose low mantissa bits then hold k
+        const double shifter = 6755399441055744.0;
+        double k_shifted = y * log2e + shifter;
+        double k = k_shifted - shifter;
+        double r = (y - k * ln2_hi) - k * ln2_lo;
+
+        // exp(r); Taylor series of degree 13
+        double p = 1.0 / 6227020800.0;
+        p = p * r + 1.0 / 479001600.0;
+        p = p * r + 1.0 / 39916800.0;
+        p = p * r + 1.0 / 3628800.0;
+        p = p * r + 1.0 / 362880.0;
+        p = p * r + 1.0 / 40320.0;
+        p = p * r + 1.0 / 5040.0;
+        p = p * r + 1.0 / 720.0;
+        p = p * r + 1.0 / 120.0;
+        p = p * r + 1.0 / 24.0;
+        p = p * r + 1.0 / 6.0;
+        p = p * r + 0.5;
+        p = p * r + 1.0;
+        p = p * r + 1.0;
+
+        // 2^k
+        uint64_t bits;
+        std::memcpy(&bits, &k_shifted, sizeof(double));
+        bits = (bits + 1023) << 52;
+        double scale;
+        std::memcpy(&scale, &bits, sizeof(double));
+
+        return p * scale;
+    }
+
+    // d^k for a small non negative integer k
+    inline double pow_integer(double d, int k)
+    {
+        double p = 1.0;
+        for (int j = 0; j < k; j++)
+        {
+            p *= d;
+        }
+
+        return p;
+    }
+
+    // Values and gradients for a given power function
+    template <typename T, typename PowFunction>
+    inline void evaluate_with(const Parameters& params, double px, double py,
+        const T* xs, const T* ys, size_t n, double* r, double* dr_dx,
+        double* dr_dy, PowFunction pow_q)
+    {
+        const double c2 = params.c2;
+        const double two_q = 2.0 * params.q;
+
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+        {
+            double d1 = px - (double) xs[i];
+            double d2 = py - (double) ys[i];
+            double d = d1 * d1 + d2 * d2 + c2;
+
+            // r = d^q; dr/dx = 2 q d^(q-1) (x - x_s)
+            double ri = pow_q(d);
+            double g = two_q * ri / d;
+
+            r[i] = ri;
+            dr_dx[i] = g * d1;
+            dr_dy[i] = g * d2;
+        }
+    }
+
+    // Values for a given power function
+    template <typename T, typename PowFunction>
+    inline void values_with(const Parameters& params, double px, double py,
+        const T* xs, const T* ys, size_t n, double* r, PowFunction pow_q)
+    {
+        const double c2 = params.c2;
+
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+        {
+            double d1 = px - (double) xs[i];
+            double d2 = py - (double) ys[i];
+
+            r[i] = pow_q(d1 * d1 + d2 * d2 + c2);
+        }
+    }
+
+    /**
+    * Evaluates the multiquadric values and gradients (with respect to the
+    * interest point) for a set of support nodes.
+    *
+    * @param params Kernel parameters.
+    * @param px, py Interest point.
+    * @param xs, ys Support nodes coordinates (SoA).
+    * @param n Number of support nodes.
+    * @param r, dr_dx, dr_dy Output arrays of size n.
+    */
+    template <typename T>
+    inline void evaluate(const Parameters& params, double px, double py,
+        const T* xs, const T* ys, size_t n, double* r, double* dr_dx,
+        double* dr_dy)
+    {
+        const int k = params.k;
+        const double q = params.q;
+
+        switch (params.kind)
+        {
+            case ExponentKind::INTEGER:
+                evaluate_with(params, px, py, xs, ys, n, r, dr_dx, dr_dy,
+                    [k](double d) { return pow_integer(d, k); });
+                break;
+
+            case ExponentKind::HALF_INTEGER:
+                evaluate_with(params, px, py, xs, ys, n, r, dr_dx, dr_dy,
+                    [k](double d) { return pow_integer(d, k) * std::sqrt(d); });
+                break;
+
+            default:
+                evaluate_with(params, px, py, xs, ys, n, r, dr_dx, dr_dy,
+                    [q](double d) { return exp_bounded(q * log_positive(d)); });
+                break;
+        }
+    }
+
+    // Evaluates the multiquadric values only (see evaluate)
+    template <typename T>
+    inline void values(const Parameters& params, double px, double py,
+        const T* xs, const T* ys, size_t n, double* r)
+    {
+        const int k = params.k;
+        const double q = params.q;
+
+        switch (params.kind)
+        {
+            case ExponentKind::INTEGER:
+                values_with(params, px, py, xs, ys, n, r,
+                    [k](double d) { return pow_integer(d, k); });
+                break;
+
+            case ExponentKind::HALF_INTEGER:
+                values_with(params, px, py, xs, ys, n, r,
+                    [k](double d) { return pow_integer(d, k) * std::sqrt(d); });
+                break;
+
+            default:
+                values_with(params, px, py, xs, ys, n, r,
+                    [q](double d) { return exp_bounded(q * log_positive(d)); });
+                break;
+        }
+    }
+}
@@ -11,6 +11,8 @@
 #include "./gq_line_rpim.h"
 
 
+// T: coordinates scalar type (float or double)
+template <typename T>
 class PointcloudRPIM
 {
     public:
@@ -21,58 +23,56 @@ class PointcloudRPIM
             size_t volume_quadr_interp, size_t surface_quadr_interp);
 
         // Get global cloud
-        geom::PointCloud<double> get_cloud(void) { return m_cloud; }
+        const geom::PointCloudSoA<T>& get_cloud(void) const { return m_cloud; }
 
         // Get number of volume quadrature points
-        size_t get_number_of_volume_quadrature_points(void) { return m_volume_gq_pts_num; }
+        size_t get_number_of_volume_quadrature_points(void) const { return m_volume_gq_pts_num; }
 
     public:
         // Get number of volume cells
-        size_t get_volume_cells_number(void) { return m_volume_cell_props.size(); }
+        size_t get_volume_cells_number(void) const {
+            return m_volume_gq.get_integration_cells_properties().size(); }
 
         // Get quadrature properties background volume cell 
-        std::vector<GQTriangleRPIM::CellProperties>
-            get_quadrature_volume_cells_properties(void);
+        const std::vector<GQTriangleRPIM::CellProperties>&
+            get_quadrature_volume_cells_properties(void) const;
 
         // Get quadrature weights of background volume cell
-        std::vector<double> get_quadrature_volume_cells_weights(void);
+        const std::vector<double>& get_quadrature_volume_cells_weights(void) const;
 
     public:
 
+        // Get number of surface quadrature points
+        size_t get_number_of_surface_quadrature_points(void) const { return m_surface_gq_pts_num; }
+
         // Get number of surface cells
-        size_t get_surface_cells_number(void) { return m_surface_cells_props.size(); }
+        size_t get_surface_cells_number(void) const {
+            return m_surface_gq.get_integration_cells_properties().size(); }
 
         // Get quadrature properties background surface cell 
-        std::vector<GQLineRPIM::CellProperties>
-            get_quadrature_surface_cells_properties(void);
+        const std::vector<GQLineRPIM::CellProperties>&
+            get_quadrature_surface_cells_properties(void) const;
 
         // Get quadrature weights of background surface cell
-        std::vector<double> get_quadrature_surface_cells_weights(void);
+        const std::vector<double>& get_quadrature_surface_cells_weights(void) const;
         
     private: 
 
-        // Mesh
-        Mesh2D m_field_nodes_mesh;
-
         // Number of field nodes
         size_t m_field_nodes_num;
 
         // Generate data points structure
-        void generate_data_points(void);
+        void generate_data_points(const Mesh2D& field_nodes_mesh,
+            const geom::PointCloudSoA<T>& volume_gq_pts,
+            const geom::PointCloudSoA<T>& surface_gq_pts);
 
         // Quadrature point check
         void quadrature_points_check(void);
 
         // Global cloud
-        geom::PointCloud<double> m_cloud;
+        geom::PointCloudSoA<T> m_cloud;
 
     private:
-        // Generate volume quadrature points
-        void generate_volume_quadrature_points(void);
-
-        // Volume quadrature points
-        geom::PointCloud<double> m_volume_gq_pts;
-
         // Number of volume quadrature points
         size_t m_volume_gq_pts_num;
 
@@ -82,20 +82,8 @@ class PointcloudRPIM
         // Quadrature sampling for volume element
         size_t m_volume_quadr_interp;
 
-        // Background volume cell properties
-        std::vector<GQTriangleRPIM::CellProperties> m_volume_cell_props;
-
-        // Weights of background volume cell
-        std::vector<double> m_volume_cell_quadr_weights;
-
     private:
 
-        // Generate surface quadrature points
-        void generate_surface_quadrature_points(void);
-
-        // Surface quadrature points
-        geom::PointCloud<double> m_surface_gq_pts;
-
         // Number of surface quadrature points
         size_t m_surface_gq_pts_num;
 
@@ -104,10 +92,4 @@ class PointcloudRPIM
 
         // Quadrature sampling for surface elements
         size_t m_surface_quadr_interp; 
-        
-        // Background surface cell properties
-        std::vector<GQLineRPIM::CellProperties> m_surface_cells_props;
-
-        // Weights of background surface cell
-        std::vector<double> m_surface_cell_quadr_weights;
-};
\ No newline at end of file
+};
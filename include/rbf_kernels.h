@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+#include "mq_kernels.h"
+
+/* Radial basis function policies of the RPIM shape functions. The kernels are
+parametrised (as in the RPIM literature) by the shape constant ac, the nodal
+spacing dc and the exponent q. A policy provides:
+- compact: true if the kernel vanishes beyond a finite radius; the moment
+  matrix Gs is then sparse and factorised skipping its zeros.
+- zero_diagonal: true if the kernel vanishes at r = 0; Gs then has a zero
+  diagonal and is only factorised with pivoting.
+- evaluate: values and gradients (with respect to the interest point) over
+  the SoA coordinates of a support set.
+- values: values only. */
+namespace rbf {
+
+    /**
+    * Evaluates a radial kernel and its gradient for a set of support nodes.
+    * radial(d, g) returns the kernel value for the squared distance d and
+    * sets g, so that the gradient is g * (x - x_s).
+    */
+    template <typename T, typename Radial>
+    inline void evaluate_radial(double px, double py, const T* xs, const T* ys,
+        size_t n, double* r, double* dr_dx, double* dr_dy, Radial radial)
+    {
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+        {
+            double d1 = px - (double) xs[i];
+            double d2 = py - (double) ys[i];
+            double g;
+
+            r[i] = radial(d1 * d1 + d2 * d2, g);
+            dr_dx[i] = g * d1;
+            dr_dy[i] = g * d2;
+        }
+    }
+
+    // Evaluates a radial kernel for a set of support nodes (see evaluate_radial)
+    template <typename T, typename Radial>
+    inline void values_radial(double px, double py, const T* xs, const T* ys,
+        size_t n, double* r, Radial radial)
+    {
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++)
+        {
+            double d1 = px - (double) xs[i];
+            double d2 = py - (double) ys[i];
+            double g;
+
+            r[i] = radial(d1 * d1 + d2 * d2, g);
+        }
+    }
+
+    // Multiquadric; (r^2 + (ac dc)^2)^q
+    struct Multiquadric
+    {
+        static constexpr bool compact = false;
+        static constexpr bool zero_diagonal = false;
+
+        Multiquadric(double ac, double dc, double q) :
+            m_params(mq::make_parameters(ac, dc, q)) {}
+
+        template <typename T>
+        void evaluate(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r, double* dr_dx, double* dr_dy) const
+        {
+            mq::evaluate(m_params, px, py, xs, ys, n, r, dr_dx, dr_dy);
+        }
+
+        template <typename T>
+        void values(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r) const
+        {
+            mq::values(m_params, px, py, xs, ys, n, r);
+        }
+
+    private:
+        // Kernel parameters (exponent classified once)
+        mq::Parameters m_params;
+    };
+
+    // Gaussian; exp(-ac (r / dc)^2)
+    struct Gaussian
+    {
+        static constexpr bool compact = false;
+        static constexpr bool zero_diagonal = false;
+
+        Gaussian(double ac, double dc, double) : m_a(ac / (dc * dc)) {}
+
+        template <typename T>
+        void evaluate(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r, double* dr_dx, double* dr_dy) const
+        {
+            evaluate_radial(px, py, xs, ys, n, r, dr_dx, dr_dy, radial());
+        }
+
+        template <typename T>
+        void values(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r) const
+        {
+            values_radial(px, py, xs, ys, n, r, radial());
+        }
+
+    private:
+        // Decay rate ac / dc^2
+        double m_a;
+
+        // exp(-a d); g = -2 a exp(-a d) (underflow clamped)
+        auto radial(void) const
+        {
+            const double a = m_a;
+
+            return [a](double d, double& g) {
+                double ri = mq::exp_bounded(std::max(-a * d, -700.0));
+                g = -2.0 * a * ri;
+                return ri; };
+        }
+    };
+
+    /* Thin plate spline; r^q (q not an even integer, e.g. 4.001). Its Gs has a
+    zero diagonal, so it is always factorised with pivoting. */
+    struct ThinPlateSpline
+    {
+        static constexpr bool compact = false;
+        static constexpr bool zero_diagonal = true;
+
+        ThinPlateSpline(double, double, double q) : m_q(q) {}
+
+        template <typename T>
+        void evaluate(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r, double* dr_dx, double* dr_dy) const
+        {
+            evaluate_radial(px, py, xs, ys, n, r, dr_dx, dr_dy, radial());
+        }
+
+        template <typename T>
+        void values(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r) const
+        {
+            values_radial(px, py, xs, ys, n, r, radial());
+        }
+
+    private:
+        // Exponent
+        double m_q;
+
+        // d^(q/2); g = q d^(q/2 - 1) (r = 0 is clamped to a vanishing value)
+        auto radial(void) const
+        {
+            const double q = m_q;
+
+            return [q](double d, double& g) {
+                d = std::max(d, 1.0e-300);
+                double ri = mq::exp_bounded(std::max(0.5 * q * mq::log_positive(d),
+                    -700.0));
+                g = q * ri / d;
+                return ri; };
+        }
+    };
+
+    // Wendland C2; (1 - s)_+^4 (4 s + 1), s = r / (ac dc)
+    struct WendlandC2
+    {
+        static constexpr bool compact = true;
+        static constexpr bool zero_diagonal = false;
+
+        WendlandC2(double ac, double dc, double) :
+            m_inv_delta2(1.0 / ((ac * dc) * (ac * dc))) {}
+
+        template <typename T>
+        void evaluate(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r, double* dr_dx, double* dr_dy) const
+        {
+            evaluate_radial(px, py, xs, ys, n, r, dr_dx, dr_dy, radial());
+        }
+
+        template <typename T>
+        void values(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r) const
+        {
+            values_radial(px, py, xs, ys, n, r, radial());
+        }
+
+    private:
+        // Inverse squared support radius
+        double m_inv_delta2;
+
+        // g = -20 (1 - s)_+^3 / delta^2
+        auto radial(void) const
+        {
+            const double inv_delta2 = m_inv_delta2;
+
+            return [inv_delta2](double d, double& g) {
+                double s = std::sqrt(d * inv_delta2);
+                double t = std::max(1.0 - s, 0.0);
+                double t3 = t * t * t;
+                g = -20.0 * t3 * inv_delta2;
+                return t3 * t * (4.0 * s + 1.0); };
+        }
+    };
+
+    // Wendland C4; (1 - s)_+^6 (35 s^2 + 18 s + 3), s = r / (ac dc)
+    struct WendlandC4
+    {
+        static constexpr bool compact = true;
+        static constexpr bool zero_diagonal = false;
+
+        WendlandC4(double ac, double dc, double) :
+            m_inv_delta2(1.0 / ((ac * dc) * (ac * dc))) {}
+
+        template <typename T>
+        void evaluate(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r, double* dr_dx, double* dr_dy) const
+        {
+            evaluate_radial(px, py, xs, ys, n, r, dr_dx, dr_dy, radial());
+        }
+
+        template <typename T>
+        void values(double px, double py, const T* xs, const T* ys, size_t n,
+            double* r) const
+        {
+            values_radial(px, py, xs, ys, n, r, radial());
+        }
+
+    private:
+        // Inverse squared support radius
+        double m_inv_delta2;
+
+        // g = -56 (1 - s)_+^5 (5 s + 1) / delta^2
+        auto radial(void) const
+        {
+            const double inv_delta2 = m_inv_delta2;
+
+            return [inv_delta2](double d, double& g) {
+                double s = std::sqrt(d * inv_delta2);
+                double t = std::max(1.0 - s, 0.0);
+                double t2 = t * t;
+                double t5 = t2 * t2 * t;
+                g = -56.0 * t5 * (5.0 * s + 1.0) * inv_delta2;
+                return t5 * t * (35.0 * s * s + 18.0 * s + 3.0); };
+        }
+    };
+}
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <armadillo>
 
 #include "geom.h"
@@ -16,13 +17,20 @@
 #include "./support_domain.h"
 #include "./geometry_model.h"
 #include "./shape_function.h"
+#include "./shape_tuner.h"
 #include "./strain.h"
 #include "./point_loads.h"
+#include "./assembly.h"
+#include "./bsr_matrix.h"
 
 #include <boost/tuple/tuple.hpp>
 #include "gnuplot-iostream.h"
 #include <bits/stdc++.h>
 
+/* T: scalar type of the geometric pipeline (cloud, neighbour search,
+quadrature points and support domains). Shape functions, state vectors and
+stiffness matrices are kept in double precision. */
+template <typename T = double>
 class RPIM2D 
 {
     public:
@@ -36,27 +44,55 @@ class RPIM2D
         void update(const arma::dvec& q_bar);
 
         // Get number of dofs
-        size_t get_dofs_num(void) { return m_dofs_num; }
+        size_t get_dofs_num(void) const { return m_dofs_num; }
 
         // Get initial field nodes mesh
-        Mesh2D get_initial_field_nodes_mesh(void) { return m_field_nodes_mesh_initial; }
+        const Mesh2D& get_initial_field_nodes_mesh(void) const { return m_field_nodes_mesh_initial; }
+
+        /**
+        * Assembles the stiffness blocks and the external force vectors over the
+        * quadrature points, in parallel (see geom::AssemblyStrategy):
+        * K = sum_k w_k k_el(x_k) and fex = sum_k w_k f_bex(x_k) over the volume
+        * points, plus sum_j w_j f_tex(x_j) over the surface points and the
+        * point loads; w is the quadrature weight * cell measure * thickness.
+        * Called by initialize (Total Lagrangian) and update; it can be called
+        * again in the same configuration (e.g. parameter sweeps). The symbolic
+        * phase only runs when the supporting nodes change; otherwise the values
+        * are accumulated into the existing patterns. In a Total Lagrangian
+        * analysis update only re-evaluates the external forces (the loads may
+        * depend on the state), gathering the precomputed shape functions.
+        *
+        * @param q_bar The global vector of deformations.
+        * @param stiffness If false, only the external forces are assembled and
+        * the stiffness blocks are kept.
+        */
+        void assemble(const arma::dvec& q_bar, bool stiffness = true);
 
     public:
 
         // Active external force vector getter
-        arma::dvec get_external_force_vector_a(void) const { return m_fex_a; }
+        const arma::dvec& get_external_force_vector_a(void) const { return m_fex_a; }
 
         // Constrained external force vector getter
-        arma::dvec get_external_force_vector_c(void) const { return m_fex_c; }
+        const arma::dvec& get_external_force_vector_c(void) const { return m_fex_c; }
+
+        /* Stiffness blocks of the boundary-first partition; the constrained
+        dofs c are the first m_dofs_per_node * m_boundaries_num ones (see
+        get_boundary_state_vector) and the active dofs a the rest. The kac
+        block is the transpose of kca; kcc and kaa are symmetric (upper block
+        triangle storage). */
 
         // Get kcc matrix
-        arma::dmat get_kcc_matrix(void) const { return m_kfcc; }
+        const BSRMatrix& get_kcc_matrix(void) const { return m_kfcc; }
 
         // Get kca matrix
-        arma::dmat get_kca_matrix(void) const { return m_kfca; }
+        const BSRMatrix& get_kca_matrix(void) const { return m_kfca; }
 
         // Get kaa matrix
-        arma::dmat get_kaa_matrix(void) const { return m_kfaa; }
+        const BSRMatrix& get_kaa_matrix(void) const { return m_kfaa; }
+
+        // Gs factorisation cache statistics, summed over the thread models
+        FactorisationCache::Stats get_factorisation_cache_stats(void) const;
 
     public:
 
@@ -81,8 +117,8 @@ class RPIM2D
         // Number of field nodes
         size_t m_field_nodes_num;
 
-        // Dofs per node
-        int m_dofs_per_node = 2;
+        // Spatial dimension and dofs per node (plane elasticity)
+        static constexpr size_t m_dim = 2, m_dofs_per_node = 2;
 
         // Total number of dofs
         size_t m_dofs_num;
@@ -97,8 +133,59 @@ class RPIM2D
         // External forces
         arma::dvec m_fex_c, m_fex_a;
 
-        // Stiffness matrices
-        arma::dmat m_kfcc, m_kfca, m_kfaa;
+        // Stiffness matrices (2 x 2 node blocks; a block row holds the nodes
+        // sharing a support)
+        BSRMatrix m_kfcc, m_kfca, m_kfaa;
+
+        static_assert(m_dofs_per_node == BSRMatrix::block_size, "The stiffness "
+            "blocks are the couplings of two nodes");
+
+        /* Symbolic phase of the assembly; sets the patterns of the stiffness
+        blocks (couplings of the nodes sharing the support domain of a volume
+        point), the slot map and the value buffers */
+        void assemble_symbolic(void);
+
+        /* Stiffness (added to the slots of k_values, if any) and body forces
+        (added to fex) of a volume quadrature point */
+        void volume_point_contributions(GeometryModel<T, m_dim, m_dofs_per_node>&
+            geom_model, const assembly::QuadraturePoint& pt, const arma::dvec& q_bar,
+            const BSRMatrix::Index* slots, double* k_values, arma::dvec& fex) const;
+
+        // Tractions of a surface quadrature point (added to fex)
+        void surface_point_contributions(GeometryModel<T, m_dim, m_dofs_per_node>&
+            geom_model, const assembly::QuadraturePoint& pt, const arma::dvec& q_bar,
+            arma::dvec& fex) const;
+
+        /* Slot map of the volume points; the local node block (i, j) of point
+        p (ns support nodes) is added to the block m_k_slot_map[m_volume_slots[p]
+        + j * ns + i] of the concatenated block values [kcc, kca, kaa]. The kac
+        blocks (transposed kca) and the lower triangle ones are discarded. */
+        std::vector<BSRMatrix::Index> m_k_slot_map;
+        std::vector<size_t> m_volume_slots;
+
+        /* Concatenated stiffness values and external forces per thread (thread
+        buffers; the colouring only uses the first ones) */
+        std::vector<std::vector<double>> m_k_values;
+        std::vector<arma::dvec> m_f_values;
+
+        // Pattern version of the support domain table the patterns belong to
+        size_t m_pattern_version = 0;
+
+    private:
+        // Volume and surface quadrature points (support domain table order)
+        std::vector<assembly::QuadraturePoint> m_volume_points, m_surface_points;
+
+        // Set the quadrature points of the background cells
+        void set_quadrature_points(void);
+
+        // Colours of the quadrature points (see assembly::colour_points)
+        std::vector<std::vector<size_t>> m_volume_colours, m_surface_colours;
+
+        // Pattern version of the support domain table the colours belong to
+        size_t m_colours_version = 0;
+
+        // Colour the quadrature points of the current support domains
+        void colour_quadrature_points(void);
 
         // Point loads
         PointLoads m_point_load;
@@ -106,16 +193,29 @@ class RPIM2D
     private:        
 
         // Pointcloud handler 
-        PointcloudRPIM m_pc_rpim;
+        PointcloudRPIM<T> m_pc_rpim;
 
         // Update field nodes mesh and cloud    
         void update_field_nodes_mesh_and_cloud(const arma::dvec& q_bar);
 
-        // Global cloud
-        geom::PointCloud<double> m_cloud, m_cloud_initial;
+        // Global cloud (current configuration)
+        geom::PointCloudSoA<T> m_cloud;
+
+        // Global cloud (initial configuration; owned by the pointcloud handler)
+        const geom::PointCloudSoA<T>& get_initial_cloud(void) const {
+            return m_pc_rpim.get_cloud(); }
 
         // Support domain handle
-        SupportDomain m_sup_domain;
+        SupportDomain<T> m_sup_domain;
+
+        // Support domains of the quadrature points
+        typename SupportDomain<T>::SupportDomainTable m_sup_domain_table;
+
+        /* Geometry models of the quadrature points, one per thread; in the Total
+        Lagrangian formulation the first one holds the precomputed shape function
+        tables and the others share them */
+        std::vector<std::unique_ptr<GeometryModel<T, m_dim, m_dofs_per_node>>>
+            m_geom_models;
     
         // Support domain radius 
         geom::RPIMParameters m_search_params;
@@ -128,20 +228,10 @@ class RPIM2D
         // Quadrature sampling for surface elements
         const short int m_volume_quadr_interp = GQTriangleRPIM::QUADRATIC;
 
-        // Quadrature properties of background volume cell
-        std::vector<GQTriangleRPIM::CellProperties> m_volume_cell_props;
-
-        // Quadrature weights of background volume cell
-        std::vector<double> m_volume_cell_quadr_weights;
-
-    private: 
-
         // Quadrature sampling for surface elements
         const short int m_surface_quadr_interp = 3; 
 
-        // Quadrature properties of background surface cell
-        std::vector<GQLineRPIM::CellProperties> m_surface_cell_props;
-
-        // Quadrature weights of background surface cell
-        std::vector<double> m_surface_cell_quadr_weights;
+        /* The quadrature properties and weights of the background volume and
+        surface cells are owned by the pointcloud handler (m_pc_rpim) and are
+        accessed through its const reference getters. */
 };
\ No newline at end of file
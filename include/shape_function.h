@@ -4,52 +4,376 @@
 #include <vector>
 #include <armadillo>
 
+#include "geom.h"
+#include "dense_kernels.h"
+#include "rbf_kernels.h"
+#include "shape_measures.h"
+#include "factorisation_cache.h"
+
+/* Radial point interpolation shape functions. Rbf is the radial basis policy
+(see rbf_kernels.h); with a compactly supported kernel the Gs factorisation
+skips the zeros of the sparse moment matrix.
+
+Shape functions accept support coordinates of scalar type T (float or
+double). The moment matrix Gs, its factorisation and the measures are always
+evaluated in double precision for conditioning. */
+template <typename Rbf = rbf::Multiquadric>
 class ShapeFunction
 {
 
 public:
+    // Spatial dimension of the support domains
+    static constexpr size_t dim = 2;
+
+    /**
+    * @param ac Shape constant.
+    * @param dc Nodal spacing.
+    * @param q Exponent of the kernel.
+    * @param ms Size of the polynomial basis; 0 (none), 3 (linear) or 6
+    * (quadratic). Throws std::invalid_argument otherwise.
+    */
     ShapeFunction(double ac, double dc, double q, int ms=3);
 
     // Returns the vector and its jacoban
-    struct VecJac {
-        // Vector
-        arma::dvec vec;
+    using VecJac = shape::VecJac;
+
+    // Shape function measures
+    using Measures = shape::Measures;
+
+    // Radial basis function (Rbf policy); written into vec_jac
+    template <typename T>
+    void radial_basis(const arma::dvec& x, const geom::PointSetView<T>& sup_dom,
+        VecJac& vec_jac) const;
+
+    /* Polynomial function (m=3: [1, u, v]; m=6: [1, u, v, u^2, u v, v^2]) in
+    the scaled local coordinates u = (x - x0) / dc, v = (y - y0) / dc; written
+    into vec_jac (jacobian with respect to x) */
+    void polynomial2D_basis(const arma::dvec& x, double x0, double y0,
+        VecJac& vec_jac) const;
+    
+    /**
+    * Calculates the shape function measures at x. The intermediate matrices
+    * are taken from the workspace of this object, so a ShapeFunction must not
+    * be shared between threads.
+    *
+    * @param x Interest point.
+    * @param sup_dom Coordinates of the support domain nodes.
+    * @param phis_str Output measures (its memory is reused between calls).
+    * @param support_indices Sorted indices of the support domain nodes. If
+    * given, the Gs factorisation is cached and reused by every point with the
+    * same support set (see clear_cache).
+    */
+    template <typename T>
+    void calculate(const arma::dvec& x, const geom::PointSetView<T>& sup_dom,
+        Measures& phis_str, const size_t* support_indices = nullptr);
+
+    /* Number of support domains factorised in lockstep by calculate_batch
+    (twice as many in mixed precision mode) */
+    static constexpr size_t batch_width = 4;
+
+    /**
+    * Calculates the shape function measures of a group of interest points.
+    * The points are grouped by (padded) Gs size and the systems of each group
+    * are factorised and solved in lockstep, batch_width at a time, with the
+    * inner loops vectorised across the support domains. The lockstep
+    * elimination is not pivoted; the systems it fails on (zero pivot or
+    * element growth) are solved one at a time with pivoting, as are all the
+    * systems of kernels with a zero diagonal. The factorisation cache and
+    * the stencil reuse mode are not used.
+    *
+    * @param xs, ys Interest points coordinates.
+    * @param sup_doms Support domains of the interest points.
+    * @param count Number of interest points.
+    * @param phis_strs Output measures of the count interest points.
+    */
+    template <typename T>
+    void calculate_batch(const T* xs, const T* ys,
+        const geom::PointSetView<T>* sup_doms, size_t count, Measures* phis_strs);
+
+    /* Clear the Gs factorisations of support sets; required whenever the
+    nodes move (the stencil shapes only depend on relative coordinates) */
+    void clear_cache(void) { m_cache.clear_supports(); }
+
+    // Set the maximum number of cached Gs factorisations (clears the cache)
+    void set_cache_capacity(size_t capacity) { m_cache.set_capacity(capacity); }
+
+    /* Stencil reuse mode: the shape functions are evaluated in coordinates
+    local to the first support node, and the Gs factorisation is shared by all
+    support domains with the same relative geometry (translated stencils of
+    structured grids). Translating the support domain and the interest point
+    leaves the shape functions unchanged. Stencils are equal within the
+    round-off of their coordinate type (see stencil_tolerance), and a stencil
+    that matches a cached one is evaluated on the cached geometry. */
+    void set_stencil_reuse(bool stencil_reuse);
+
+    // Get Gs factorisation cache statistics
+    const FactorisationCache::Stats& get_cache_stats(void) const {
+        return m_cache.get_stats(); }
+
+    // Set the shape constant ac (clears the factorisation cache)
+    void set_shape_constant(double ac);
+
+    // Get the shape constant ac
+    double get_shape_constant(void) const { return m_ac; }
+
+    // Condition number estimates of the Gs matrices (1-norm)
+    struct ConditionStats {
+        // Number of estimates
+        size_t count = 0;
+
+        // Largest estimate
+        double max = 0.0;
 
-        // Jacobian
-        arma::dmat jac;
+        // Sum of log10 of the estimates
+        double sum_log10 = 0.0;
+
+        // Estimates above limit
+        size_t above_limit = 0;
+
+        // Conditioning bound
+        double limit = 1.0e12;
+
+        // Geometric mean of the estimates (0 if none)
+        double mean(void) const {
+            return count ? std::pow(10.0, sum_log10 / count) : 0.0; }
     };
 
-    struct Measures {
-        // Phis vector
-        arma::dvec phis_vec;
+    /* Condition monitor: a condition estimate of Gs is recorded for every
+    support domain calculated (Hager's 1-norm estimator on the LDL^T
+    factors, a few O(n^2) solves; cache hits reuse the estimate of the
+    cached factors). Off by default; calculate_batch then solves one point
+    at a time. */
+    void set_condition_monitor(bool condition_monitor);
+
+    // Condition estimate of the last support domain calculated
+    double get_last_condition(void) const { return m_last_condition; }
 
-        // Phis jacobian
-        arma::dmat phis_jac;
+    // Get condition statistics
+    const ConditionStats& get_condition_stats(void) const { return m_condition_stats; }
 
-        // Phis Matrix
-        arma::dmat phis_mat;
+    // Reset condition statistics, counting the estimates above limit
+    void reset_condition_stats(double limit = 1.0e12) {
+        m_condition_stats = ConditionStats(); m_condition_stats.limit = limit; }
+
+    // Mixed precision solves
+    struct MixedPrecisionStats {
+        // Systems factorised in single precision
+        size_t solves = 0;
+
+        // Refinement steps (a lockstep batch counts once)
+        size_t refinements = 0;
+
+        // Systems refactorised in double precision
+        size_t fallbacks = 0;
     };
 
-    // Radial basis function (multi-quadrics)
-    VecJac rbf_mq(const arma::dvec& x,
-        const std::vector<arma::dvec>& sup_dom);
+    /* Mixed precision mode: the Gs systems are factorised in single
+    precision, in calculate_batch with twice the lanes per vector register,
+    and the solutions are refined in double precision (at most
+    max_refinements steps). A system whose residual does not reach
+    refinement_tol (relative to ||Gs|| ||sol|| + ||rhs||, infinity norms),
+    e.g. an ill conditioned one, is refactorised in double precision. The
+    cache (calculate with support indices, stencil reuse mode) keeps the
+    single precision factors together with Gs, so that hits are refined as
+    well; a refactorised system keeps its double precision factors. Off by
+    default; the condition monitor always factorises in double precision.
+    The refinement costs a few O(n^2) residuals and solves per system, so it
+    only pays off where the O(n^3) factorisation dominates (large support
+    domains, wide vector units). */
+    void set_mixed_precision(bool mixed_precision) {
+        m_mixed_precision = mixed_precision; }
 
-    // Polynomial function (linear basis; m=3)
-    VecJac polynomial2D_basis(const arma::dvec& x);
-    
-    // Calculate 
-    Measures calculate(const arma::dvec& x, const std::vector<arma::dvec>& sup_dom);
+    // Get mixed precision statistics
+    const MixedPrecisionStats& get_mixed_precision_stats(void) const {
+        return m_mixed_stats; }
+
+    // Refinement steps of a mixed precision solve
+    static constexpr size_t max_refinements = 2;
+
+    // Relative residual accepted by the mixed precision solves
+    static constexpr double refinement_tol = 1.0e-12;
 
 private:
     // Shape function constants
     double m_ac, m_dc, m_q;
 
-    // Polynomial basis order
-    int m_ms;
+    // Radial basis kernel
+    Rbf m_rbf;
+
+    // Polynomial basis size (0, 3 or 6)
+    size_t m_ms;
+
+    // Stencil reuse mode (see set_stencil_reuse)
+    bool m_stencil_reuse = false;
+
+    /* Coordinates tolerance of equal stencil shapes in exact coordinates;
+    widened to the round-off of the coordinates by stencil_tolerance */
+    double m_stencil_tol;
+
+    // Condition monitor (see set_condition_monitor)
+    bool m_condition_monitor = false;
+
+    // Condition estimates
+    ConditionStats m_condition_stats;
+
+    // Last condition estimate
+    double m_last_condition = 0.0;
+
+    // Mixed precision mode (see set_mixed_precision)
+    bool m_mixed_precision = false;
+
+    // Mixed precision statistics
+    MixedPrecisionStats m_mixed_stats;
 
 private: 
-    // Gs matrix
-    arma::dmat gs_matrix(const std::vector<arma::dvec>& sup_dom);
-};
+    /* Gs matrix; written into the zeroed gs_mat of size at least ns + ms.
+    Rows and columns beyond ns + ms are padded with the identity, so that the
+    padded system has the same solution. */
+    template <typename T>
+    void gs_matrix(const geom::PointSetView<T>& sup_dom, arma::dmat& gs_mat) const;
+
+    /* Polynomial terms of the basis at the scaled local coordinates (u, v);
+    written into p (size ms). The local origin is the first support node, in
+    both gs_matrix and rhs_matrix. */
+    void polynomial_terms(double u, double v, double* p) const;
+
+    /* Flags the polynomial terms the support nodes can resolve (size ms). A
+    quadratic term that is a combination of the previous terms over the
+    support (e.g. u^2 when the nodes lie on two columns) would make Gs
+    singular; it is dropped by both gs_matrix (identity padded) and
+    rhs_matrix (zero right hand side). The linear terms are always kept. */
+    template <typename T>
+    void polynomial_terms_active(const geom::PointSetView<T>& sup_dom,
+        bool* active) const;
+
+    /* Right hand sides [p_x, dp_x/dx1, dp_x/dx2] with p_x = [r(x); p(x)];
+    written into the zeroed rhs_mat (padded rows are left zero) */
+    template <typename T>
+    void rhs_matrix(const arma::dvec& x, const geom::PointSetView<T>& sup_dom,
+        arma::dmat& rhs_mat);
+
+    /* Solves gs * sol = rhs_mat in place with a pivoted LDL^T factorisation
+    of the symmetric indefinite gs matrix; rhs_mat is overwritten by the
+    solution. The factors are taken from the cache if available, otherwise gs
+    is built in gs_mat (storage of size at least ns + ms) and factorised
+    (in mixed precision mode in single precision first; see solve_mixed, and
+    sparse elimination first for compact kernels). */
+    template <typename T>
+    void solve_system(const geom::PointSetView<T>& sup_dom,
+        const size_t* support_indices, arma::dmat& gs_mat, arma::dmat& rhs_mat);
+
+    /* Solves gs * sol = rhs_mat in place with single precision (pivoted)
+    factors of gs (in the workspace gs_float and pivots) and double precision
+    refinement (gs is left unchanged). Returns false, with rhs_mat restored,
+    if the factorisation fails or the refinement does not converge. */
+    bool solve_mixed(const arma::dmat& gs_mat, size_t n, arma::dmat& rhs_mat);
+
+    /* Solves gs * sol = rhs_mat in place with single precision factors of gs
+    (pivots piv) and refines the solution against gs in double precision.
+    Returns false, with rhs_mat restored, if the refinement does not
+    converge. */
+    template <typename FactorsType, typename GsType>
+    bool refine_mixed(const FactorsType& ldl_float, const dense::Pivot* piv,
+        const GsType& gs, size_t n, arma::dmat& rhs_mat);
+
+    /* Solves the interleaved lockstep systems of the workspace (batch_gs and
+    batch_rhs, W lanes) with single precision factors and double precision
+    refinement; batch_rhs is overwritten by the solutions. ok is false for
+    the lanes that failed (batch_rhs0 then holds their right hand sides). */
+    template <size_t W>
+    void solve_lockstep_mixed(size_t n, bool* ok);
+
+    /* Coordinates tolerance of equal stencil shapes for a stencil with local
+    origin (x0, y0) and coordinates of type T: the local coordinates of two
+    translated stencils differ by the round-off of T at the magnitude of the
+    coordinates */
+    template <typename T>
+    double stencil_tolerance(double x0, double y0) const;
+
+    // Records a condition estimate
+    void record_condition(double cond);
+
+    // Copies the measures from the solution Gs^-1 * rhs (Gs is symmetric)
+    void set_measures(const arma::dmat& sol_mat, size_t ns,
+        Measures& phis_str) const;
+
+    // Calculate dispatching on the size of the gs system
+    template <typename T>
+    void calculate_system(const arma::dvec& x, const geom::PointSetView<T>& sup_dom,
+        Measures& phis_str, const size_t* support_indices);
+
+    // Calculate with stack storage; the system is padded to size N
+    template <size_t N, typename T>
+    void calculate_fixed(const arma::dvec& x, const geom::PointSetView<T>& sup_dom,
+        Measures& phis_str, const size_t* support_indices);
+
+    /* Calculate the points idx[0, lanes) of a batch in lockstep; their systems
+    are padded to the largest system of the batch (at most N). S is the
+    scalar type of the factorisation; lanes <= batch_width in double
+    precision and 2 * batch_width in single precision. */
+    template <typename S, size_t N, typename T>
+    void calculate_lockstep(const T* xs, const T* ys,
+        const geom::PointSetView<T>* sup_doms, const size_t* idx, size_t lanes,
+        Measures* phis_strs);
+
+    // calculate_lockstep for the padded system size (16, 24, 32 or 40)
+    template <typename S, typename T>
+    void calculate_lockstep_sized(size_t size, const T* xs, const T* ys,
+        const geom::PointSetView<T>* sup_doms, const size_t* idx, size_t lanes,
+        Measures* phis_strs);
 
+    // Calculate with workspace storage; any support domain size
+    template <typename T>
+    void calculate_dynamic(const arma::dvec& x, const geom::PointSetView<T>& sup_dom,
+        Measures& phis_str, const size_t* support_indices);
 
+private:
+    /* Scratch memory of calculate. The matrices keep their allocation between
+    calls, so once the largest support domain has been seen no further heap
+    allocations take place. */
+    struct Workspace {
+        // Rbf and polynomial vectors and jacobians at the interest point
+        VecJac ri_vecjac, pi_vecjac;
+
+        // Gs matrix and its factors (dynamic path)
+        arma::dmat gs_mat;
+
+        // Right hand sides and solution (dynamic path)
+        arma::dmat rhs_mat;
+
+        // Support coordinates relative to the local origin (stencil reuse)
+        std::vector<double> local_x, local_y;
+
+        // Coordinates tolerance of the current stencil (stencil reuse)
+        double stencil_tol = 0.0;
+
+        // Interleaved gs matrices and right hand sides (batched path)
+        std::vector<double, geom::AlignedAllocator<double>> batch_gs, batch_rhs;
+
+        /* Interleaved single precision factors, right hand sides and
+        residuals (mixed precision batched path) */
+        std::vector<float, geom::AlignedAllocator<float>> batch_gs_float;
+        std::vector<double, geom::AlignedAllocator<double>> batch_rhs0, batch_res;
+
+        // Single precision factors, right hand sides and residuals (mixed precision)
+        arma::fmat gs_float;
+        arma::dmat rhs_copy, res_mat;
+
+        // Points of the current size group (batched path)
+        std::vector<size_t> batch_idx;
+
+        // Non zero rows of a Gs column (sparse factorisation)
+        std::vector<size_t> sparse_rows;
+
+        // Pivots of the Gs factors
+        std::vector<dense::Pivot> pivots;
+
+        // Scratch vectors of the condition estimate
+        arma::dvec cond_x, cond_z;
+    };
+
+    Workspace m_ws;
+
+    // Gs factorisations by support set
+    FactorisationCache m_cache;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <armadillo>
+
+#include "aligned_allocator.h"
+
+// Shape function quantities shared by the shape function constructions
+namespace shape {
+
+    // Returns the vector and its jacoban
+    struct VecJac {
+        // Vector
+        arma::dvec vec;
+
+        // Jacobian
+        arma::dmat jac;
+    };
+
+    struct Measures {
+        // Phis vector
+        arma::dvec phis_vec;
+
+        // Phis jacobian
+        arma::dmat phis_jac;
+    };
+
+    /* Measures of many interest points in flat storage. The measures of a
+    point are stored at the offsets of its support domain in the support
+    domain table (compressed row layout), so the table has no offsets of its
+    own. */
+    struct MeasuresTable {
+        // Phis and the columns of the phis jacobian
+        std::vector<double, geom::AlignedAllocator<double>> phi, dphi_dx, dphi_dy;
+
+        // Number of stored measures
+        size_t size(void) const { return phi.size(); }
+
+        // Resize to nnz measures
+        void resize(size_t nnz)
+        {
+            phi.resize(nnz); dphi_dx.resize(nnz); dphi_dy.resize(nnz);
+        }
+
+        // Store the measures of a point at offset
+        void set(size_t offset, const Measures& phis_str)
+        {
+            size_t ns = phis_str.phis_vec.n_elem;
+
+            std::copy_n(phis_str.phis_vec.memptr(), ns, phi.data() + offset);
+            std::copy_n(phis_str.phis_jac.colptr(0), ns, dphi_dx.data() + offset);
+            std::copy_n(phis_str.phis_jac.colptr(1), ns, dphi_dy.data() + offset);
+        }
+
+        // Gather the ns measures of a point at offset (memory of phis_str reused)
+        void get(size_t offset, size_t ns, Measures& phis_str) const
+        {
+            phis_str.phis_vec.set_size(ns);
+            phis_str.phis_jac.set_size(ns, 2);
+
+            std::copy_n(phi.data() + offset, ns, phis_str.phis_vec.memptr());
+            std::copy_n(dphi_dx.data() + offset, ns, phis_str.phis_jac.colptr(0));
+            std::copy_n(dphi_dy.data() + offset, ns, phis_str.phis_jac.colptr(1));
+        }
+    };
+}
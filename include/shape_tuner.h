@@ -0,0 +1,84 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <armadillo>
+
+#include "geom.h"
+#include "support_domain.h"
+#include "shape_function.h"
+
+// Settings of the shape constant search
+struct ShapeTunerSettings
+{
+    // Conditioning bound of the Gs matrices (1-norm estimate)
+    double max_condition = 1.0e12;
+
+    // Shape constants searched; [ac_min, ac_max] (log spaced candidates)
+    double ac_min = 0.25, ac_max = 16.0;
+
+    // Number of candidates
+    size_t candidates = 16;
+
+    // Bisection steps refining the best candidate
+    size_t refinements = 6;
+
+    // Support domains sampled per tuning (0: all)
+    size_t samples = 64;
+};
+
+/* Picks the shape constant ac of the radial basis Rbf for a support domain
+table (the smallest support size the analysis admits). The largest sampled
+condition number estimate of Gs (see ShapeFunction::set_condition_monitor) is
+kept within the bound; among the admissible constants, the one closest to the
+bound (the flattest basis, usually the most accurate) is taken. Having no
+monotonicity assumption, it works for kernels that sharpen (Gaussian) or
+flatten (multiquadrics, Wendland) with ac.
+
+T: coordinates scalar type of the support domains (float or double). */
+template <typename T, typename Rbf = rbf::Multiquadric>
+class ShapeTuner
+{
+public:
+    /**
+    * @param rpim_params RPIM parameters (dc and q of the kernel).
+    * @param ms Polynomial basis order of the shape functions.
+    * @param settings Search settings.
+    */
+    ShapeTuner(const geom::RPIMParameters& rpim_params, int ms = 0,
+        const ShapeTunerSettings& settings = ShapeTunerSettings());
+
+    // Shape constant of the whole table (per model)
+    double tune(const typename SupportDomain<T>::SupportDomainTable& sd_table);
+
+    /**
+    * Shape constant of a subset of the table points.
+    *
+    * @param sd_table Support domain table.
+    * @param points Indices of the table points.
+    * @return Tuned shape constant; if no candidate is admissible, the best
+    * conditioned one.
+    */
+    double tune(const typename SupportDomain<T>::SupportDomainTable& sd_table,
+        const std::vector<size_t>& points);
+
+    /**
+    * Largest condition number estimate of the sampled support domains.
+    *
+    * @param sd_table Support domain table.
+    * @param points Indices of the sampled table points.
+    * @param ac Shape constant.
+    */
+    double max_condition(const typename SupportDomain<T>::SupportDomainTable& sd_table,
+        const std::vector<size_t>& points, double ac);
+
+private:
+    // Search settings
+    ShapeTunerSettings m_settings;
+
+    // Shape functions with the condition monitor on
+    ShapeFunction<Rbf> m_sf;
+
+    // Shape function measures (discarded)
+    shape::Measures m_phis;
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <armadillo>
+
+#include "bsr_matrix.h"
+
+/* Local stiffness kernels of plane elasticity, K = Ds^T * C * Ds, formed
+directly from the shape function derivatives. The node blocks of Ds are
+Di_s = [[dx_i, 0], [0, dy_i], [dy_i, dx_i]] and C has no shear coupling
+(isotropic or orthotropic materials), so the block (i, j) is
+
+    K_ij = [[c11 dx_i dx_j + c33 dy_i dy_j, c12 dx_i dy_j + c33 dy_i dx_j],
+            [c12 dy_i dx_j + c33 dx_i dy_j, c22 dy_i dy_j + c33 dx_i dx_j]]
+
+Only the blocks i <= j are computed (K_ji = K_ij^T); for a fixed j they are
+evaluated over i with SIMD. */
+namespace stiffness {
+
+    // Constants of a constitutive matrix without shear coupling
+    struct PlaneConstants
+    {
+        double c11, c22, c12, c33;
+    };
+
+    /**
+    * Constants of a 3 x 3 constitutive matrix (Voigt notation [e11, e22,
+    * g12]).
+    *
+    * @param c_mat Constitutive matrix.
+    * @param c Output constants.
+    * @return False if c_mat is not symmetric or couples the shear strain
+    * with the normal ones (the kernels do not apply).
+    */
+    inline bool plane_constants(const arma::dmat& c_mat, PlaneConstants& c)
+    {
+        if (c_mat.n_rows != 3 || c_mat.n_cols != 3)
+        {
+            return false;
+        }
+
+        if (c_mat.at(0, 2) != 0.0 || c_mat.at(2, 0) != 0.0 ||
+            c_mat.at(1, 2) != 0.0 || c_mat.at(2, 1) != 0.0 ||
+            c_mat.at(0, 1) != c_mat.at(1, 0))
+        {
+            return false;
+        }
+
+        c = {c_mat.at(0, 0), c_mat.at(1, 1), c_mat.at(0, 1), c_mat.at(2, 2)};
+
+        return true;
+    }
+
+    /**
+    * Blocks (i, j) of a column of node blocks, for i in [0, count); their
+    * entries are written to k00[i], k01[i], k10[i] and k11[i].
+    *
+    * @param dx, dy Shape function derivatives of the nodes i.
+    * @param dx_j, dy_j Shape function derivatives of the node j.
+    * @param c Constitutive constants.
+    * @param weight Weight of the blocks.
+    */
+    inline void block_column(const double* dx, const double* dy, size_t count,
+        double dx_j, double dy_j, const PlaneConstants& c, double weight,
+        double* k00, double* k01, double* k10, double* k11)
+    {
+        // Weighted constants of the column
+        const double p = weight * c.c11 * dx_j, q = weight * c.c33 * dy_j;
+        const double r = weight * c.c12 * dy_j, s = weight * c.c33 * dx_j;
+        const double t = weight * c.c12 * dx_j, u = weight * c.c22 * dy_j;
+
+        #pragma omp simd
+        for (size_t i = 0; i < count; i++)
+        {
+            k00[i] = dx[i] * p + dy[i] * q;
+            k01[i] = dx[i] * r + dy[i] * s;
+            k10[i] = dy[i] * t + dx[i] * q;
+            k11[i] = dy[i] * u + dx[i] * s;
+        }
+    }
+
+    /* Makes the diagonal block (j, j) exactly symmetric if it is in the chunk
+    [first, first + count) of the block column j (k01 and k10 are rounded
+    differently) */
+    inline void symmetric_diagonal(size_t first, size_t count, size_t j,
+        const double* k01, double* k10)
+    {
+        if (j - first < count)
+        {
+            k10[j - first] = k01[j - first];
+        }
+    }
+
+    // Nodes per chunk of a block column (stack workspace)
+    constexpr size_t chunk_size = 64;
+
+    /**
+    * Local stiffness (2 ns x 2 ns; local dof 2 i + c is component c of node
+    * i). The upper blocks are computed and mirrored.
+    *
+    * @param dx, dy Shape function derivatives of the support nodes.
+    * @param ns Number of support nodes.
+    * @param c Constitutive constants.
+    * @param out Output matrix (its memory is reused).
+    */
+    inline void local_stiffness(const double* dx, const double* dy, size_t ns,
+        const PlaneConstants& c, arma::dmat& out)
+    {
+        out.set_size(2 * ns, 2 * ns);
+
+        double k00[chunk_size], k01[chunk_size], k10[chunk_size], k11[chunk_size];
+
+        for (size_t j = 0; j < ns; j++)
+        {
+            double* col0 = out.colptr(2 * j);
+            double* col1 = out.colptr(2 * j + 1);
+
+            for (size_t first = 0; first <= j; first += chunk_size)
+            {
+                size_t count = std::min(chunk_size, j + 1 - first);
+                block_column(dx + first, dy + first, count, dx[j], dy[j], c, 1.0,
+                    k00, k01, k10, k11);
+                symmetric_diagonal(first, count, j, k01, k10);
+
+                for (size_t k = 0; k < count; k++)
+                {
+                    size_t i = first + k;
+                    col0[2 * i] = k00[k]; col0[2 * i + 1] = k10[k];
+                    col1[2 * i] = k01[k]; col1[2 * i + 1] = k11[k];
+                }
+            }
+        }
+
+        // Lower triangle
+        size_t n = 2 * ns;
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t i = j + 1; i < n; i++)
+            {
+                out.at(i, j) = out.at(j, i);
+            }
+        }
+    }
+
+    /**
+    * Adds the weighted local stiffness to the block values of block sparse
+    * matrices without forming it (see BSRMatrix::add_local). Each pair of
+    * support nodes is evaluated once: the block (i, j), i <= j, is added to
+    * slot (i, j) and its transpose to slot (j, i).
+    *
+    * @param dx, dy Shape function derivatives of the support nodes.
+    * @param ns Number of support nodes.
+    * @param c Constitutive constants.
+    * @param weight Weight of the local stiffness.
+    * @param slots Block slot of each node pair (i, j), at j * ns + i.
+    * @param values Block values the slots refer to.
+    */
+    inline void add_local_stiffness(const double* dx, const double* dy, size_t ns,
+        const PlaneConstants& c, double weight, const BSRMatrix::Index* slots,
+        double* values)
+    {
+        double k00[chunk_size], k01[chunk_size], k10[chunk_size], k11[chunk_size];
+
+        for (size_t j = 0; j < ns; j++)
+        {
+            for (size_t first = 0; first <= j; first += chunk_size)
+            {
+                size_t count = std::min(chunk_size, j + 1 - first);
+                block_column(dx + first, dy + first, count, dx[j], dy[j], c,
+                    weight, k00, k01, k10, k11);
+                symmetric_diagonal(first, count, j, k01, k10);
+
+                for (size_t k = 0; k < count; k++)
+                {
+                    size_t i = first + k;
+
+                    // Block (i, j)
+                    BSRMatrix::Index s = slots[j * ns + i];
+                    if (s != BSRMatrix::discarded)
+                    {
+                        double* v = values + BSRMatrix::block_values * s;
+                        v[0] += k00[k]; v[1] += k01[k];
+                        v[2] += k10[k]; v[3] += k11[k];
+                    }
+
+                    // Block (j, i) = (i, j)^T
+                    s = slots[i * ns + j];
+                    if (i != j && s != BSRMatrix::discarded)
+                    {
+                        double* v = values + BSRMatrix::block_values * s;
+                        v[0] += k00[k]; v[1] += k10[k];
+                        v[2] += k01[k]; v[3] += k11[k];
+                    }
+                }
+            }
+        }
+    }
+}
@@ -2,41 +2,120 @@
 
 #include <iostream>
 #include <vector>
+#include <array>
 #include <armadillo>
-#include "shape_function.h"
+#include "shape_measures.h"
 
+/* Strain measure of a field with Dofs components per node in Dim spatial
+dimensions.
+- Dofs == Dim: small strain of a displacement field in Voigt notation
+  (2D: [e11, e22, g12]).
+- Dofs == 1: gradient of a scalar field (e.g. temperature).
+
+The strain operator Ds = [D1_s, ..., Dns_s] is not materialised; its node
+blocks are applied from the shape function derivatives over their non zero
+entries only. */
+template <size_t Dim, size_t Dofs>
 class Strain
 {
+    static_assert(Dofs == Dim || Dofs == 1, "Strain is defined for vector "
+        "fields (Dofs == Dim) and scalar fields (Dofs == 1)");
 
 public:
+    // Number of strain components
+    static constexpr size_t strain_size = (Dofs == 1) ? Dim : Dim * (Dim + 1) / 2;
+
+    // Non zero entry of a node block Di_s: Di_s(row, comp) = dphi_i/dx_deriv
+    struct DsEntry { size_t row, comp, deriv; };
+
+    // Number of non zero entries of a node block
+    static constexpr size_t ds_entries_num = (Dofs == 1) ? Dim : Dim * Dim;
+
+    // Non zero entries of a node block (normal strains first, then shear)
+    static constexpr std::array<DsEntry, ds_entries_num> ds_entries(void);
+
     Strain() {};
     
     // Set shape function
-    void set_shape_function(const ShapeFunction::Measures& sf);
+    void set_shape_function(const shape::Measures& sf);
 
     // Update function
     void update(const arma::dvec& es);
 
     // Get strain vector
-    arma::dvec get_strain_vector(void) { return m_strain_vector; }
+    const arma::dvec& get_strain_vector(void) const { return m_strain_vector; }
 
-    // Get Ds matrix
-    arma::dmat get_ds_matrix(void) { return m_ds_matrix; }
+    /**
+    * Applies the transposed strain operator; out = Ds^T * v.
+    *
+    * @param v Vector of size strain_size (e.g. the stress C * strain).
+    * @param out Output local vector of size Dofs * ns.
+    */
+    void apply_ds_transpose(const arma::dvec& v, arma::dvec& out) const;
+
+    /**
+    * Local stiffness out = Ds^T * C * Ds; blocks (i, j) are formed from the
+    * non zero entries of the node blocks, the lower ones mirrored. Plane
+    * elasticity without shear coupling uses stiffness::local_stiffness.
+    *
+    * @param c_mat Symmetric matrix of size strain_size (constitutive).
+    * @param out Output matrix of size Dofs * ns.
+    */
+    void ds_congruence(const arma::dmat& c_mat, arma::dmat& out);
+
+    // Ds matrix (assembled on demand; not used by the kernels)
+    arma::dmat get_ds_matrix(void) const;
 
 private:
-    // Shape function s handle
-    ShapeFunction::Measures m_sf_s;
+    // Shape function s handle (referenced; must outlive the update)
+    const shape::Measures* m_sf_s;
 
     // Number of support domain points
     size_t m_ns;
 
 private:
     // Strain vector
-    arma::dvec m_strain_vector;
+    arma::vec::fixed<strain_size> m_strain_vector;
 
-    // Ds matrix 
-    arma::dmat m_ds_matrix;
+    // C * Di_s of the support nodes (ds_congruence workspace)
+    std::vector<arma::mat::fixed<strain_size, Dofs>> m_cd_blocks;
 };
 
+// Non zero entries of a node block
+template <size_t Dim, size_t Dofs>
+constexpr std::array<typename Strain<Dim, Dofs>::DsEntry,
+    Strain<Dim, Dofs>::ds_entries_num> Strain<Dim, Dofs>::ds_entries(void)
+{
+    std::array<DsEntry, ds_entries_num> entries{};
+    size_t e = 0;
+
+    if constexpr (Dofs == 1)
+    {
+        // Di_s = [dphi/dx1; ...; dphi/dxDim]
+        for (size_t a = 0; a < Dim; a++)
+        {
+            entries[e++] = {a, 0, a};
+        }
+    }
+    else
+    {
+        // Normal strains; Di_s(a, a) = dphi/dxa
+        for (size_t a = 0; a < Dim; a++)
+        {
+            entries[e++] = {a, a, a};
+        }
 
+        // Shear strains; Voigt pairs (2D: 12; 3D: 23, 13, 12)
+        size_t row = Dim;
+        for (size_t b = Dim - 1; b > 0; b--)
+        {
+            for (size_t a = b; a-- > 0; row++)
+            {
+                entries[e++] = {row, a, b};
+                entries[e++] = {row, b, a};
+            }
+        }
+    }
 
+    return entries;
+}
@@ -16,7 +16,7 @@ class Structured2DMesh
             const geom::Point<double>& pt2, int pts_x, int pts_y);
 
         // Get triangular 2D mesh
-        Mesh2D get_2D_mesh(void) { return m_mesh; }
+        const Mesh2D& get_2D_mesh(void) const { return m_mesh; }
 
         // Get nodal spacing
         double get_nodal_spacing(void) { return m_dc; }
@@ -22,32 +22,93 @@ typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
 typedef CGAL::Point_set_2<K>::Vertex_handle Vertex_handle;
 
 
+// T: coordinates scalar type (float or double)
+template <typename T>
 class SupportDomain
 {
 
 public:
     SupportDomain() {};
 
+    // Support domain of a single interest point (view into the table)
     struct SupportDomainPoint
     {
-        // Point idx (that's a gaussian pointgTgt)
+        // Point idx (index of the interest point in the data points)
         size_t point_idx;
 
         // Coordinates of index point
-        arma::dvec point_coords;
+        T point_x, point_y;
+
+        // Number of supporting nodes
+        size_t ns;
+
+        // Supporting nodes indices
+        const size_t* support_indices;
+
+        // Coordinates of supporting nodes (planar view; z reads as 0)
+        geom::PointSetView<T> support_coords;
+    };
+
+    // Support domains of all interest points in flat (compressed row) storage
+    struct SupportDomainTable
+    {
+        // Index of each interest point in the data points
+        std::vector<size_t> point_idx;
+
+        // Coordinates of interest points
+        std::vector<T, geom::AlignedAllocator<T>> point_x, point_y;
+
+        // Support domain k spans [offsets[k], offsets[k+1])
+        std::vector<size_t> offsets;
 
         // Supporting nodes indices
         std::vector<size_t> support_indices;
 
-        // Coordinates of support_indices
-        std::vector<arma::dvec> support_coords;
+        // Coordinates of supporting nodes (packed per interest point)
+        std::vector<T, geom::AlignedAllocator<T>> support_x, support_y;
+
+        /* Generation counter, increased every time the table is generated;
+        quantities derived from the support coordinates are stale once it
+        changes */
+        size_t version = 0;
+
+        /* Pattern counter, increased when a generation changes the offsets or
+        the supporting nodes indices; quantities derived from the indices only
+        (assembly patterns, colours) are stale once it changes */
+        size_t pattern_version = 0;
+
+        // Number of interest points
+        size_t size(void) const { return point_idx.size(); }
+
+        // Remove all support domains (keeps the allocated memory)
+        void clear(void);
+
+        // Get support domain of interest point idx
+        SupportDomainPoint at(size_t idx) const
+        {
+            size_t offset = offsets[idx];
+            size_t ns = offsets[idx + 1] - offset;
+
+            return {point_idx[idx], point_x[idx], point_y[idx], ns,
+                support_indices.data() + offset, {support_x.data() + offset,
+                support_y.data() + offset, nullptr, ns}};
+        }
     };
     
-    // Generate support domain
-    std::vector<SupportDomainPoint> generate(
-        const geom::PointCloud<double>& field_nodes,
-        const geom::PointCloud<double>& data_pts,
-        const geom::RPIMParameters& rpim_params, bool animate=false);
+    /**
+    * Generates the support domains of the interest points. The first
+    * field_nodes_num data points are the field nodes; the rest are the interest
+    * (quadrature) points.
+    *
+    * @param data_pts Field nodes followed by the interest points.
+    * @param field_nodes_num Number of field nodes.
+    * @param rpim_params RPIM parameters.
+    * @param sup_dom_table Output table (its memory is reused between calls).
+    * @param animate Animate support domains.
+    */
+    void generate(const geom::PointCloudSoA<T>& data_pts,
+        size_t field_nodes_num, const geom::RPIMParameters& rpim_params,
+        SupportDomainTable& sup_dom_table, bool animate=false);
 
 private:
 
@@ -64,12 +125,14 @@ private:
 
 private:
 
+    // Radius search matches (reused between interest points and updates)
+    typename KDTrees<T>::Matches m_matches;
+
     // Gnuplot handle 
     Gnuplot m_gp;
 
     // Animate support domain
-    void animate_support_domain(const geom::PointCloud<double>& cloud,
-        const geom::PointCloud<double>& field_nodes,
-        const std::vector<SupportDomainPoint>& sup_dom_pts, double rect_width,
-        double rect_height);
+    void animate_support_domain(const geom::PointCloudSoA<T>& cloud,
+        size_t field_nodes_num, const SupportDomainTable& sup_dom_table,
+        double rect_width, double rect_height);
 };
\ No newline at end of file
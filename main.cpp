@@ -20,7 +20,7 @@ int main(void)
     int ptx_iter = iter; int pty_iter = iter;
     int pts_x = (2 * ptx_iter); int pts_y = (2 * pty_iter);
     Structured2DMesh str_mesh_raw(pt1, pt2, pts_x, pts_y);
-    Mesh2D mesh_raw = str_mesh_raw.get_2D_mesh();
+    const Mesh2D& mesh_raw = str_mesh_raw.get_2D_mesh();
 
     // RPIM parameters
     geom::RPIMParameters rpim_params;
@@ -34,7 +34,7 @@ int main(void)
     double thickness = 1.0;
 
     // Generate model
-    RPIM2D cantilever_beam;
+    RPIM2D<double> cantilever_beam;
     cantilever_beam.initialize(mesh_raw, thickness, rpim_params, true);
 
     /************************* Static linear analysis **********6***************/
@@ -0,0 +1,49 @@
+#include "../include/assembly.h"
+
+// Colour quadrature points
+template <typename T>
+std::vector<std::vector<size_t>> assembly::colour_points(const
+    typename SupportDomain<T>::SupportDomainTable& sd_table,
+    const std::vector<QuadraturePoint>& points, size_t nodes_num)
+{
+    std::vector<std::vector<size_t>> colours;
+
+    // Support nodes taken by each colour
+    std::vector<std::vector<bool>> taken;
+
+    for (size_t p = 0; p < points.size(); p++)
+    {
+        size_t idx = points[p].idx;
+        const size_t* first = sd_table.support_indices.data() + sd_table.offsets[idx];
+        const size_t* last = sd_table.support_indices.data() + sd_table.offsets[idx + 1];
+
+        // First colour none of the support nodes belongs to
+        size_t c = 0;
+        for (; c < colours.size(); c++)
+        {
+            if (std::none_of(first, last, [&](size_t node) { return taken[c][node]; }))
+            {
+                break;
+            }
+        }
+
+        if (c == colours.size())
+        {
+            colours.emplace_back();
+            taken.emplace_back(nodes_num, false);
+        }
+
+        colours[c].push_back(p);
+        std::for_each(first, last, [&](size_t node) { taken[c][node] = true; });
+    }
+
+    return colours;
+}
+
+// Explicit instantiations
+template std::vector<std::vector<size_t>> assembly::colour_points<float>(const
+    SupportDomain<float>::SupportDomainTable&, const std::vector<QuadraturePoint>&,
+    size_t);
+template std::vector<std::vector<size_t>> assembly::colour_points<double>(const
+    SupportDomain<double>::SupportDomainTable&, const std::vector<QuadraturePoint>&,
+    size_t);
@@ -2,27 +2,24 @@
 
 BoundaryConditions::BoundaryConditions(const Mesh2D& mesh_raw)
 {
-    // Get mesh (reference mesh)
-    m_mesh_raw = mesh_raw;
-
     // Set boundary points indices
-    set_boundary_pts_indices();
+    set_boundary_pts_indices(mesh_raw);
 
     // Generate field nodes mesh
-    generate_field_nodes_mesh();
+    generate_field_nodes_mesh(mesh_raw);
 
     // Update boundary indices
     update_boundaries();
 }
 
 // Set boundary point indices
-void BoundaryConditions::set_boundary_pts_indices(void)
+void BoundaryConditions::set_boundary_pts_indices(const Mesh2D& mesh_raw)
 {
     /*Set the boundaries as the points that are less than x_thresh of the x
     range */
     // Get field nodes vector
     auto field_nodes_vec = geom::conv_pc_to_pc_vec<double>(
-        m_mesh_raw.node_coords);
+        mesh_raw.node_coords);
 
     // Calculate range in y direction
     auto range = gp_utils::find_vector_range<double>(field_nodes_vec.x);
@@ -31,9 +28,9 @@ void BoundaryConditions::set_boundary_pts_indices(void)
     double x_thresh = range.min + m_bound_x_scale_factor * std::abs(range.val);
 
     // Loop through field nodes and assign boundary indices and pointsj
-    for (size_t i = 0; i < m_mesh_raw.node_coords.pts.size(); i++)
+    for (size_t i = 0; i < mesh_raw.node_coords.pts.size(); i++)
     {
-        if (m_mesh_raw.node_coords.pts.at(i).x < x_thresh)
+        if (mesh_raw.node_coords.pts.at(i).x < x_thresh)
         {
             m_boundary_pts_indices.push_back(i);
         }
@@ -43,7 +40,7 @@ void BoundaryConditions::set_boundary_pts_indices(void)
     m_boundaries_num = m_boundary_pts_indices.size();
 
     // Create free points indices
-    for(size_t i = 0; i < m_mesh_raw.node_coords.pts.size(); i++)
+    for(size_t i = 0; i < mesh_raw.node_coords.pts.size(); i++)
     {
         m_free_pts_indices.push_back(i);
     }
@@ -60,10 +57,10 @@ void BoundaryConditions::set_boundary_pts_indices(void)
 
 
 // Generate field nodes mesh
-void BoundaryConditions::generate_field_nodes_mesh(void)
+void BoundaryConditions::generate_field_nodes_mesh(const Mesh2D& mesh_raw)
 {
     // Indices of field nodes mesh
-    m_mesh.node_indices = m_mesh_raw.node_indices;
+    m_mesh.node_indices = mesh_raw.node_indices;
 
     // Desired indices format
     std::vector<size_t> state_format;
@@ -73,17 +70,19 @@ void BoundaryConditions::generate_field_nodes_mesh(void)
         m_free_pts_indices.end());
 
     // Nodes coordinates for field nodes mesh
+    m_mesh.node_coords.pts.reserve(state_format.size());
     for (size_t i = 0; i < state_format.size(); i++)
     {
-        auto pt_i = m_mesh_raw.node_coords.pts.at(state_format.at(i));
+        auto pt_i = mesh_raw.node_coords.pts.at(state_format.at(i));
         m_mesh.node_coords.pts.push_back(pt_i);
     }
 
     // Elements for field nodes mesh
-    for (size_t i = 0; i < m_mesh_raw.volume_elements.size(); i++)
+    m_mesh.volume_elements.reserve(mesh_raw.volume_elements.size());
+    for (size_t i = 0; i < mesh_raw.volume_elements.size(); i++)
     {
         // Element i for triangle mesh
-        auto element_i_triangle_mesh = m_mesh_raw.volume_elements.at(i);
+        auto element_i_triangle_mesh = mesh_raw.volume_elements.at(i);
 
         // Initialize element i for field mesh
         geom::Triangular2DElement element_i_field_mesh;
@@ -106,10 +105,11 @@ void BoundaryConditions::generate_field_nodes_mesh(void)
     }
 
     // Boundary elements for field nodes mesh
-    for (size_t i = 0; i < m_mesh_raw.bound_elements.size(); i++)
+    m_mesh.bound_elements.reserve(mesh_raw.bound_elements.size());
+    for (size_t i = 0; i < mesh_raw.bound_elements.size(); i++)
     {
         // Boundaery element i for triangle mesh
-        auto b_element_i_triangle_mesh = m_mesh_raw.bound_elements.at(i);
+        auto b_element_i_triangle_mesh = mesh_raw.bound_elements.at(i);
 
         // Initialize boundary element i for field mesh
         geom::LineElement b_element_i_field_mesh;
@@ -124,14 +124,11 @@ void BoundaryConditions::generate_field_nodes_mesh(void)
         // Push to field nodes mesh
         m_mesh.bound_elements.push_back(b_element_i_field_mesh);
     }
-
-    // Initial field nodes mesh
-    m_mesh_initial = m_mesh;
 }
 
 // Get the index of a specified element in a vector
 size_t BoundaryConditions::get_index_of_specified_value(
-    std::vector<size_t> v, size_t k)
+    const std::vector<size_t>& v, size_t k)
 {
     auto it = std::find(v.begin(), v.end(), k);
  
@@ -0,0 +1,143 @@
+#include "../include/bsr_matrix.h"
+
+// Set pattern
+void BSRMatrix::set_pattern(size_t n_block_rows, size_t n_block_cols,
+    std::vector<Index> row_ptr, std::vector<Index> col_idx, bool symmetric)
+{
+    m_n_block_rows = n_block_rows;
+    m_n_block_cols = n_block_cols;
+    m_symmetric = symmetric;
+    m_row_ptr = std::move(row_ptr);
+    m_col_idx = std::move(col_idx);
+    m_values.assign(block_values * m_col_idx.size(), 0.0);
+}
+
+// Slot of a block
+BSRMatrix::Index BSRMatrix::slot(size_t block_row, size_t block_col) const
+{
+    if (m_symmetric && block_col < block_row)
+    {
+        return discarded;
+    }
+
+    auto first = m_col_idx.begin() + m_row_ptr[block_row];
+    auto last = m_col_idx.begin() + m_row_ptr[block_row + 1];
+    auto it = std::lower_bound(first, last, (Index) block_col);
+
+    return (it != last && *it == block_col) ? it - m_col_idx.begin() :
+        m_col_idx.size();
+}
+
+// Add local matrix
+void BSRMatrix::add_local(const arma::dmat& k_local, double weight,
+    const Index* slots, double* values)
+{
+    size_t ns = k_local.n_rows / block_size;
+    size_t ld = k_local.n_rows;
+
+    for (size_t j = 0; j < ns; j++)
+    {
+        // Columns 2 j and 2 j + 1 of the local matrix
+        const double* k0 = k_local.colptr(block_size * j);
+        const double* k1 = k0 + ld;
+
+        for (size_t i = 0; i < ns; i++)
+        {
+            Index s = slots[j * ns + i];
+            if (s == discarded)
+            {
+                continue;
+            }
+
+            double* v = values + block_values * s;
+            v[0] += weight * k0[2 * i];
+            v[1] += weight * k1[2 * i];
+            v[2] += weight * k0[2 * i + 1];
+            v[3] += weight * k1[2 * i + 1];
+        }
+    }
+}
+
+// Matrix vector product
+arma::dvec BSRMatrix::multiply(const arma::dvec& x) const
+{
+    arma::dvec y(get_n_rows(), arma::fill::zeros);
+
+    const double* xs = x.memptr();
+    double* ys = y.memptr();
+
+    for (size_t r = 0; r < m_n_block_rows; r++)
+    {
+        double x0 = xs[2 * r], x1 = xs[2 * r + 1];
+        double y0 = 0.0, y1 = 0.0;
+
+        for (size_t k = m_row_ptr[r]; k < m_row_ptr[r + 1]; k++)
+        {
+            size_t c = m_col_idx[k];
+            const double* v = m_values.data() + block_values * k;
+
+            // y_r += A_rc x_c
+            y0 += v[0] * xs[2 * c] + v[1] * xs[2 * c + 1];
+            y1 += v[2] * xs[2 * c] + v[3] * xs[2 * c + 1];
+
+            // y_c += A_rc^T x_r (the lower triangle block)
+            if (m_symmetric && c != r)
+            {
+                ys[2 * c] += v[0] * x0 + v[2] * x1;
+                ys[2 * c + 1] += v[1] * x0 + v[3] * x1;
+            }
+        }
+
+        ys[2 * r] += y0;
+        ys[2 * r + 1] += y1;
+    }
+
+    return y;
+}
+
+// Armadillo copy
+arma::sp_mat BSRMatrix::to_sp_mat(void) const
+{
+    // Stored blocks and mirrored (lower triangle) blocks
+    size_t blocks_num = m_col_idx.size();
+    for (size_t r = 0; m_symmetric && r < m_n_block_rows; r++)
+    {
+        for (size_t k = m_row_ptr[r]; k < m_row_ptr[r + 1]; k++)
+        {
+            blocks_num += m_col_idx[k] != r ? 1 : 0;
+        }
+    }
+
+    size_t entries_num = block_values * blocks_num;
+
+    arma::umat locations(2, entries_num);
+    arma::dvec values(entries_num);
+
+    size_t n = 0;
+    for (size_t r = 0; r < m_n_block_rows; r++)
+    {
+        for (size_t k = m_row_ptr[r]; k < m_row_ptr[r + 1]; k++)
+        {
+            size_t c = m_col_idx[k];
+            const double* v = m_values.data() + block_values * k;
+
+            for (size_t e = 0; e < block_values; e++)
+            {
+                size_t row = block_size * r + e / block_size;
+                size_t col = block_size * c + e % block_size;
+
+                locations.at(0, n) = row; locations.at(1, n) = col;
+                values.at(n++) = v[e];
+
+                // Lower triangle block (the diagonal ones are stored whole)
+                if (m_symmetric && c != r)
+                {
+                    locations.at(0, n) = col; locations.at(1, n) = row;
+                    values.at(n++) = v[e];
+                }
+            }
+        }
+    }
+
+    return arma::sp_mat(locations, values, get_n_rows(), get_n_cols());
+}
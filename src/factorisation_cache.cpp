@@ -0,0 +1,277 @@
+#include "../include/factorisation_cache.h"
+
+// Set capacity
+void FactorisationCache::set_capacity(size_t capacity)
+{
+    m_slots.assign(std::max(capacity, (size_t) 1), Slot());
+    m_entries.resize(m_slots.size());
+}
+
+// Remove all the factors
+void FactorisationCache::clear(void)
+{
+    for (Slot& slot : m_slots)
+    {
+        slot.key = Key::NONE;
+    }
+}
+
+// Remove the factors of support sets
+void FactorisationCache::clear_supports(void)
+{
+    for (Slot& slot : m_slots)
+    {
+        if (slot.key == Key::SUPPORT)
+        {
+            slot.key = Key::NONE;
+        }
+    }
+}
+
+// Number of cached factorisations
+size_t FactorisationCache::size(void) const
+{
+    return std::count_if(m_slots.begin(), m_slots.end(),
+        [](const Slot& slot) { return slot.key != Key::NONE; });
+}
+
+// Find factors
+const FactorisationCache::Factors* FactorisationCache::find(const size_t* indices,
+    size_t ns)
+{
+    m_stats.lookups++;
+
+    // Compare the support sets with the same hash
+    size_t h = hash(indices, ns);
+    for (size_t e = 0; e < m_slots.size(); e++)
+    {
+        if (m_slots[e].key != Key::SUPPORT || m_slots[e].hash != h)
+        {
+            continue;
+        }
+
+        const std::vector<size_t>& entry_indices = m_entries[e].indices;
+        if (entry_indices.size() == ns &&
+            std::equal(entry_indices.begin(), entry_indices.end(), indices))
+        {
+            m_stats.hits++;
+            m_slots[e].last_use = ++m_clock;
+            return &m_entries[e].factors;
+        }
+    }
+
+    return nullptr;
+}
+
+// Insert factors
+void FactorisationCache::insert(const size_t* indices, size_t ns,
+    const arma::dmat& ldl, const dense::Pivot* piv, size_t n, double cond)
+{
+    size_t e = acquire(hash(indices, ns), Key::SUPPORT);
+
+    m_entries[e].indices.assign(indices, indices + ns);
+    store(e, ldl, piv, n, cond);
+}
+
+// Insert single precision factors
+void FactorisationCache::insert(const size_t* indices, size_t ns,
+    const arma::fmat& ldl_float, const arma::dmat& gs, const dense::Pivot* piv,
+    size_t n)
+{
+    size_t e = acquire(hash(indices, ns), Key::SUPPORT);
+
+    m_entries[e].indices.assign(indices, indices + ns);
+    store(e, ldl_float, gs, piv, n);
+}
+
+// Find factors of a shape
+const FactorisationCache::Factors* FactorisationCache::find(const
+    geom::PointSetView<double>& shape, double tol)
+{
+    m_stats.lookups++;
+
+    size_t e = find_entry(shape, tol);
+    if (e < m_slots.size())
+    {
+        m_stats.hits++;
+        m_slots[e].last_use = ++m_clock;
+        return &m_entries[e].factors;
+    }
+
+    return nullptr;
+}
+
+// Snap a shape to a cached one
+bool FactorisationCache::snap(double* x, double* y, size_t n, double tol) const
+{
+    size_t e = find_entry({x, y, nullptr, n}, tol);
+    if (e == m_slots.size())
+    {
+        return false;
+    }
+
+    std::copy(m_entries[e].x.begin(), m_entries[e].x.end(), x);
+    std::copy(m_entries[e].y.begin(), m_entries[e].y.end(), y);
+
+    return true;
+}
+
+// Find the entry of a shape
+size_t FactorisationCache::find_entry(const geom::PointSetView<double>& shape,
+    double tol) const
+{
+    // Compare the shapes with the same hash
+    size_t h = hash(shape);
+    for (size_t e = 0; e < m_slots.size(); e++)
+    {
+        if (m_slots[e].key != Key::SHAPE || m_slots[e].hash != h)
+        {
+            continue;
+        }
+
+        const Entry& entry = m_entries[e];
+        if (entry.x.size() != shape.n)
+        {
+            continue;
+        }
+
+        bool equal = true;
+        for (size_t i = 0; i < shape.n && equal; i++)
+        {
+            equal = std::abs(entry.x[i] - shape.x[i]) <= tol &&
+                std::abs(entry.y[i] - shape.y[i]) <= tol;
+        }
+
+        if (equal)
+        {
+            return e;
+        }
+    }
+
+    return m_slots.size();
+}
+
+// Insert factors of a shape
+void FactorisationCache::insert(const geom::PointSetView<double>& shape,
+    const arma::dmat& ldl, const dense::Pivot* piv, size_t n, double cond)
+{
+    size_t e = acquire(hash(shape), Key::SHAPE);
+
+    m_entries[e].x.assign(shape.x, shape.x + shape.n);
+    m_entries[e].y.assign(shape.y, shape.y + shape.n);
+    store(e, ldl, piv, n, cond);
+}
+
+// Insert single precision factors of a shape
+void FactorisationCache::insert(const geom::PointSetView<double>& shape,
+    const arma::fmat& ldl_float, const arma::dmat& gs, const dense::Pivot* piv,
+    size_t n)
+{
+    size_t e = acquire(hash(shape), Key::SHAPE);
+
+    m_entries[e].x.assign(shape.x, shape.x + shape.n);
+    m_entries[e].y.assign(shape.y, shape.y + shape.n);
+    store(e, ldl_float, gs, piv, n);
+}
+
+// Entry for a new key
+size_t FactorisationCache::acquire(size_t h, Key key)
+{
+    // Free entry, otherwise the least recently used one
+    size_t e = 0;
+    for (size_t k = 0; k < m_slots.size(); k++)
+    {
+        if (m_slots[k].key == Key::NONE)
+        {
+            e = k;
+            break;
+        }
+
+        if (m_slots[k].last_use < m_slots[e].last_use)
+        {
+            e = k;
+        }
+    }
+
+    if (m_slots[e].key != Key::NONE)
+    {
+        m_stats.evictions++;
+    }
+
+    m_slots[e].hash = h;
+    m_slots[e].key = key;
+    m_slots[e].last_use = ++m_clock;
+
+    return e;
+}
+
+// Store factors (the buffers keep their memory between entries)
+void FactorisationCache::store(size_t e, const arma::dmat& ldl,
+    const dense::Pivot* piv, size_t n, double cond)
+{
+    Factors& factors = m_entries[e].factors;
+
+    copy_block(ldl, n, factors.ldl);
+    factors.ldl_float.clear();
+    factors.gs.clear();
+    factors.piv.assign(piv, piv + n);
+    factors.n = n;
+    factors.cond = cond;
+}
+
+// Store single precision factors
+void FactorisationCache::store(size_t e, const arma::fmat& ldl_float,
+    const arma::dmat& gs, const dense::Pivot* piv, size_t n)
+{
+    Factors& factors = m_entries[e].factors;
+
+    factors.ldl.clear();
+    copy_block(ldl_float, n, factors.ldl_float);
+    copy_block(gs, n, factors.gs);
+    factors.piv.assign(piv, piv + n);
+    factors.n = n;
+    factors.cond = 0.0;
+}
+
+// Copy a leading block
+template <typename S>
+void FactorisationCache::copy_block(const arma::Mat<S>& a, size_t n,
+    std::vector<S>& v)
+{
+    v.resize(n * n);
+    for (size_t j = 0; j < n; j++)
+    {
+        std::copy_n(a.colptr(j), n, v.data() + j * n);
+    }
+}
+
+// Support set hash (FNV-1a over the indices)
+size_t FactorisationCache::hash(const size_t* indices, size_t ns)
+{
+    size_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < ns; i++)
+    {
+        h ^= indices[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+// Shape hash (FNV-1a over the quantised coordinates)
+size_t FactorisationCache::hash(const geom::PointSetView<double>& shape) const
+{
+    size_t h = 14695981039346656037ULL;
+    double inv_cell = 1.0 / m_shape_cell;
+
+    for (size_t i = 0; i < shape.n; i++)
+    {
+        h ^= (size_t) std::llround(shape.x[i] * inv_cell);
+        h *= 1099511628211ULL;
+        h ^= (size_t) std::llround(shape.y[i] * inv_cell);
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
@@ -1,112 +1,381 @@
 #include "../include/geometry_model.h"
 
-GeometryModel::GeometryModel(const
-    std::vector<SupportDomain::SupportDomainPoint>& sd_pts,
-    const geom::RPIMParameters& rpim_params)
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+GeometryModel<T, Dim, Dofs, ShapeFn>::GeometryModel(const
+    typename SupportDomain<T>::SupportDomainTable& sd_table,
+    const geom::RPIMParameters& rpim_params) : m_sf_s(rpim_params.ac > 0.0 ?
+    rpim_params.ac : rpim_params.as, rpim_params.dc, rpim_params.q, rpim_params.ms)
 {
-    // Initialize support domain points
-    m_sd_pts = sd_pts;
+    // Set support domain table
+    m_sd_table = &sd_table;
+    m_sd_table_version = sd_table.version;
+    m_phis_table_version = sd_table.version;
 
     // Set support domain search parameters
     m_search_params = rpim_params;
+
+    // Share the Gs factors of translated support domains
+    m_sf_s.set_stencil_reuse(rpim_params.local_stencils);
+
+    // Bounded Gs factorisation cache
+    m_sf_s.set_cache_capacity(rpim_params.factorisation_cache_capacity);
+
+    // Single precision Gs factors with double precision refinement
+    m_sf_s.set_mixed_precision(rpim_params.mixed_precision);
     
-    // Get elasticity matrix
-    m_c_mat = Material::get_elasticity_matrix();
+    // Get constitutive matrix
+    m_c_mat = Material::get_constitutive_matrix<Dim, Dofs>();
+
+    // Fused stiffness kernel (no shear coupling)
+    if constexpr (Dim == 2 && Dofs == 2)
+    {
+        m_fused_stiffness = stiffness::plane_constants(m_c_mat, m_plane_constants);
+    }
 }
 
 // Update strain and deformation
-void GeometryModel::update(size_t idx, const arma::dvec& q_bar, double tol)
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+void GeometryModel<T, Dim, Dofs, ShapeFn>::update(size_t idx, const arma::dvec& q_bar, double tol)
 {
     // Generate the support domain "s"
-    auto sup_dom_s = m_sd_pts.at(idx);
+    typename SupportDomain<T>::SupportDomainPoint sup_dom_s = m_sd_table->at(idx);
 
-    // Get Ls mapping matrix
-    m_ls_mat = global_to_local_mapping_matrix(sup_dom_s, q_bar.n_rows);
+    // Cached Gs factors are stale once the support domains are regenerated
+    if (m_sd_table->version != m_sd_table_version)
+    {
+        m_sf_s.clear_cache();
+        m_sd_table_version = m_sd_table->version;
+    }
 
-    // /* Nodal coordinates; for the support domain s */
-    // // Mapping from global coordinates to local cordinates
-    arma::dvec es = m_ls_mat * q_bar;
+    // Global dofs of the local dofs
+    local_to_global_dofs(sup_dom_s, m_local_dofs);
+    m_global_dofs_num = q_bar.n_rows;
 
-    /* Shape function; Calculate at the interest point for the support domain s */
-    // Calculate support function on local support domain
-    ShapeFunction sf_s(m_search_params.as, m_search_params.dc, m_search_params.q,
-        m_sf_ms);
+    // Gather the local deformations from the global ones
+    m_es.set_size(m_local_dofs.size());
+    for (size_t k = 0; k < m_local_dofs.size(); k++)
+    {
+        m_es.at(k) = q_bar.at(m_local_dofs[k]);
+    }
 
+    /* Shape function; Calculate at the interest point for the support domain s */
     // Get the interest point
-    m_x_inter = sup_dom_s.point_coords;
+    m_x_inter.at(0) = (double) sup_dom_s.point_x;
+    m_x_inter.at(1) = (double) sup_dom_s.point_y;
 
-    // Calculate shape function quantities
-    auto shape_function_s = sf_s.calculate(m_x_inter, sup_dom_s.support_coords);
+    // Shape function quantities on local support domain (gathered from the
+    // precomputed table or calculated)
+    const GeometryModel& owner = m_phis_owner ? *m_phis_owner : *this;
+    if (owner.m_phis_table.size() > 0 &&
+        owner.m_phis_table_version == m_sd_table->version)
+    {
+        owner.m_phis_table.get(m_sd_table->offsets[idx], sup_dom_s.ns, m_phis_s);
+    }
+    else
+    {
+        m_sf_s.calculate(m_x_inter, sup_dom_s.support_coords, m_phis_s,
+            sup_dom_s.support_indices);
+    }
 
     /* Deformation; Calculate deformation at the interest point for the 
-    support domain s*/
-    m_deformation = shape_function_s.phis_mat * es;
+    support domain s (u = sum_i phi_i es_i) */
+    m_deformation.zeros();
+    for (size_t i = 0; i < sup_dom_s.ns; i++)
+    {
+        double phi = m_phis_s.phis_vec.at(i);
+
+        for (size_t c = 0; c < Dofs; c++)
+        {
+            m_deformation.at(c) += phi * m_es.at(Dofs*i + c);
+        }
+    }
+
+    /* Strain; Calculate strain at the interest point for the support domain
+    s (Ds is applied implicitly) */
+    m_strain_s.set_shape_function(m_phis_s);
+    m_strain_s.update(m_es);
+}
+
+// Precompute shape functions of all the table points
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+void GeometryModel<T, Dim, Dofs, ShapeFn>::precompute_shape_functions(void)
+{
+    // All the points with the shape constant of the model
+    std::vector<size_t> points(m_sd_table->size());
+    std::iota(points.begin(), points.end(), 0);
+
+    m_phis_table.resize(m_sd_table->support_indices.size());
+    precompute_points(points);
+
+    m_phis_table_version = m_sd_table->version;
+}
+
+// Precompute the shape functions of some table points into the table
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+void GeometryModel<T, Dim, Dofs, ShapeFn>::precompute_points(const
+    std::vector<size_t>& points)
+{
+    // Batched calculation by chunks of points
+    const size_t chunk_size = 256;
+    m_phis_chunk.resize(chunk_size);
 
-    // Calculate deformation jacobian    
-    m_deformation_jac = shape_function_s.phis_mat * m_ls_mat;
+    // Interest points and support domains of a chunk
+    std::vector<T> xs(chunk_size), ys(chunk_size);
+    std::vector<geom::PointSetView<T>> sup_doms(chunk_size);
 
-    /* Strain; Calculate strain and strain jacobian at the interest point for the 
-    support domain s*/
-    Strain strain;
-    strain.set_shape_function(shape_function_s);
-    strain.update(es);
-    m_strain = strain.get_strain_vector();
+    for (size_t first = 0; first < points.size(); first += chunk_size)
+    {
+        size_t count = std::min(chunk_size, points.size() - first);
 
-    // Update ds matrix
-    m_ds_matrix = strain.get_ds_matrix();
+        for (size_t k = 0; k < count; k++)
+        {
+            size_t idx = points[first + k];
 
-    // Calculate strain jacobian
-    m_strain_jac = m_ds_matrix * m_ls_mat;
+            xs[k] = m_sd_table->point_x[idx];
+            ys[k] = m_sd_table->point_y[idx];
+            sup_doms[k] = m_sd_table->at(idx).support_coords;
+        }
+
+        m_sf_s.calculate_batch(xs.data(), ys.data(), sup_doms.data(), count,
+            m_phis_chunk.data());
+
+        for (size_t k = 0; k < count; k++)
+        {
+            m_phis_table.set(m_sd_table->offsets[points[first + k]],
+                m_phis_chunk[k]);
+        }
+    }
+}
+
+// Calculate local f_el
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+const arma::dvec& GeometryModel<T, Dim, Dofs, ShapeFn>::f_el_local(const
+    arma::dvec&, const arma::dvec&)
+{
+    // Local forces -Ds^T * C * strain
+    m_strain_s.apply_ds_transpose(-(m_c_mat * get_strain()), m_f_local);
+
+    return m_f_local;
+}
+
+// Calculate local fbex
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+const arma::dvec& GeometryModel<T, Dim, Dofs, ShapeFn>::f_bex_local(const
+    arma::dvec& x, const arma::dvec& q_bar)
+{
+    apply_phis_transpose(LoadingConditions<Dofs>::external_force_function(x, q_bar),
+        m_f_local);
+
+    return m_f_local;
+}
+
+// Calculate local ftex
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+const arma::dvec& GeometryModel<T, Dim, Dofs, ShapeFn>::f_tex_local(const
+    arma::dvec& x, const arma::dvec& q_bar)
+{
+    apply_phis_transpose(LoadingConditions<Dofs>::external_traction_function(x, q_bar),
+        m_f_local);
+
+    return m_f_local;
+}
+
+// Calculate local stifness matrix
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+const arma::dmat& GeometryModel<T, Dim, Dofs, ShapeFn>::k_el_local(const
+    arma::dvec&, const arma::dvec&)
+{
+    // Local stiffness Ds^T * C * Ds
+    m_strain_s.ds_congruence(m_c_mat, m_k_local);
+
+    return m_k_local;
+}
+
+// Add local stifness matrix to block values
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+void GeometryModel<T, Dim, Dofs, ShapeFn>::add_k_el_local(double weight,
+    const BSRMatrix::Index* slots, double* values)
+{
+    if constexpr (Dofs != BSRMatrix::block_size)
+    {
+        throw std::logic_error("GeometryModel::add_k_el_local: the node blocks "
+            "are 2 x 2");
+    }
+
+    if (m_fused_stiffness)
+    {
+        stiffness::add_local_stiffness(m_phis_s.phis_jac.colptr(0),
+            m_phis_s.phis_jac.colptr(1), m_phis_s.phis_vec.n_elem,
+            m_plane_constants, weight, slots, values);
+    }
+    else
+    {
+        m_strain_s.ds_congruence(m_c_mat, m_k_local);
+        BSRMatrix::add_local(m_k_local, weight, slots, values);
+    }
 }
 
 // Calculate f_el function
-arma::dvec GeometryModel::f_el_function(const arma::dvec& x,
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+arma::dvec GeometryModel<T, Dim, Dofs, ShapeFn>::f_el_function(const arma::dvec& x,
     const arma::dvec& q_bar)
 {
-   return - m_strain_jac.t() * m_c_mat * m_strain;
+    return scatter_vector(f_el_local(x, q_bar), q_bar.n_rows);
 }
 
 // Calculate fbex function
-arma::dvec GeometryModel::f_bex_function(const arma::dvec& x,
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+arma::dvec GeometryModel<T, Dim, Dofs, ShapeFn>::f_bex_function(const arma::dvec& x,
     const arma::dvec& q_bar)
 {
-    return m_deformation_jac.t() * LoadingConditions::external_force_function(x, q_bar);
+    return scatter_vector(f_bex_local(x, q_bar), q_bar.n_rows);
 }
 
 // Calculate ftex function
-arma::dvec GeometryModel::f_tex_function(const arma::dvec& x,
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+arma::dvec GeometryModel<T, Dim, Dofs, ShapeFn>::f_tex_function(const arma::dvec& x,
     const arma::dvec& q_bar)
 {
-    return m_deformation_jac.t() * LoadingConditions::external_traction_function(x, q_bar);
+    return scatter_vector(f_tex_local(x, q_bar), q_bar.n_rows);
 }
 
 // Calculate stifness matrix
-arma::dmat GeometryModel::k_el_function(const arma::dvec& x, const arma::dvec& q_bar)
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+arma::dmat GeometryModel<T, Dim, Dofs, ShapeFn>::k_el_function(const arma::dvec& x, const arma::dvec& q_bar)
 {
-    return m_ls_mat.t() * m_ds_matrix.t() * m_c_mat * m_ds_matrix * m_ls_mat;
+    const arma::dmat& k_local = k_el_local(x, q_bar);
+
+    // Scatter the local stiffness (support nodes are distinct)
+    arma::dmat k_global(q_bar.n_rows, q_bar.n_rows, arma::fill::zeros);
+    for (size_t b = 0; b < m_local_dofs.size(); b++)
+    {
+        for (size_t a = 0; a < m_local_dofs.size(); a++)
+        {
+            k_global.at(m_local_dofs[a], m_local_dofs[b]) = k_local.at(a, b);
+        }
+    }
+
+    return k_global;
 }
 
-// Global to local coordinates mapping
-arma::umat GeometryModel::global_to_local_mapping_matrix(const
-    SupportDomain::SupportDomainPoint& sup_dom_s, size_t q_bar_size)
+// Get strain jacobian
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+arma::dmat GeometryModel<T, Dim, Dofs, ShapeFn>::get_strain_jacobian(void) const
 {
-    // Get the number of support domain points
-    size_t ns = sup_dom_s.support_indices.size();
+    arma::dmat ds_matrix = m_strain_s.get_ds_matrix();
 
-    // Initialize ls matrix
-    arma::umat ls_mat = arma::zeros<arma::umat>(2 * ns, q_bar_size);
+    arma::dmat strain_jac(strain_size, m_global_dofs_num, arma::fill::zeros);
+    for (size_t k = 0; k < m_local_dofs.size(); k++)
+    {
+        strain_jac.col(m_local_dofs[k]) = ds_matrix.col(k);
+    }
+
+    return strain_jac;
+}
 
-    // Initialize i2 
-    arma::umat i2 = arma::eye<arma::umat>(2, 2);
+// Get deformation jacobian
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+arma::dmat GeometryModel<T, Dim, Dofs, ShapeFn>::get_deformation_jacobian(void) const
+{
+    size_t ns = m_phis_s.phis_vec.n_elem;
+
+    arma::dmat deformation_jac(Dofs, m_global_dofs_num, arma::fill::zeros);
+    for (size_t i = 0; i < ns; i++)
+    {
+        for (size_t c = 0; c < Dofs; c++)
+        {
+            deformation_jac.at(c, m_local_dofs[Dofs*i + c]) = m_phis_s.phis_vec.at(i);
+        }
+    }
+
+    return deformation_jac;
+}
+
+// Scatter a local vector
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+arma::dvec GeometryModel<T, Dim, Dofs, ShapeFn>::scatter_vector(const
+    arma::dvec& local, size_t n) const
+{
+    arma::dvec global(n, arma::fill::zeros);
+    for (size_t k = 0; k < m_local_dofs.size(); k++)
+    {
+        global.at(m_local_dofs[k]) += local.at(k);
+    }
+
+    return global;
+}
+
+// Apply the transposed shape function operator
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+void GeometryModel<T, Dim, Dofs, ShapeFn>::apply_phis_transpose(const
+    arma::dvec& v, arma::dvec& out) const
+{
+    size_t ns = m_phis_s.phis_vec.n_elem;
+
+    out.set_size(Dofs * ns);
+    for (size_t i = 0; i < ns; i++)
+    {
+        double phi = m_phis_s.phis_vec.at(i);
+
+        for (size_t c = 0; c < Dofs; c++)
+        {
+            out.at(Dofs*i + c) = phi * v.at(c);
+        }
+    }
+}
+
+// Local to global dofs
+template <typename T, size_t Dim, size_t Dofs, typename ShapeFn>
+void GeometryModel<T, Dim, Dofs, ShapeFn>::local_to_global_dofs(const
+    typename SupportDomain<T>::SupportDomainPoint& sup_dom_s,
+    std::vector<size_t>& local_dofs) const
+{
+    // Get the number of support domain points
+    size_t ns = sup_dom_s.ns;
+
+    // Memory reused between updates
+    local_dofs.resize(Dofs * ns);
 
     for (size_t i = 0; i < ns; i++)
     {
         // Get support node index
-        auto idx = sup_dom_s.support_indices.at(i);
+        size_t idx = sup_dom_s.support_indices[i];
 
-        // Set ls columns
-        ls_mat(arma::span(2*i, 2*i+1), arma::span(2*idx, 2*idx+1)) = i2;
+        // Dofs of the node
+        for (size_t c = 0; c < Dofs; c++)
+        {
+            local_dofs[Dofs*i + c] = Dofs*idx + c;
+        }
     }
-    
-    return ls_mat;
 }
+
+// Explicit instantiations
+template class GeometryModel<float, 2, 2>;
+template class GeometryModel<double, 2, 2>;
+template class GeometryModel<float, 2, 1>;
+template class GeometryModel<double, 2, 1>;
+
+template class GeometryModel<float, 2, 2, ShapeFunction<rbf::Gaussian>>;
+template class GeometryModel<double, 2, 2, ShapeFunction<rbf::Gaussian>>;
+template class GeometryModel<float, 2, 1, ShapeFunction<rbf::Gaussian>>;
+template class GeometryModel<double, 2, 1, ShapeFunction<rbf::Gaussian>>;
+
+template class GeometryModel<float, 2, 2, ShapeFunction<rbf::ThinPlateSpline>>;
+template class GeometryModel<double, 2, 2, ShapeFunction<rbf::ThinPlateSpline>>;
+template class GeometryModel<float, 2, 1, ShapeFunction<rbf::ThinPlateSpline>>;
+template class GeometryModel<double, 2, 1, ShapeFunction<rbf::ThinPlateSpline>>;
+
+template class GeometryModel<float, 2, 2, ShapeFunction<rbf::WendlandC2>>;
+template class GeometryModel<double, 2, 2, ShapeFunction<rbf::WendlandC2>>;
+template class GeometryModel<float, 2, 1, ShapeFunction<rbf::WendlandC2>>;
+template class GeometryModel<double, 2, 1, ShapeFunction<rbf::WendlandC2>>;
+
+template class GeometryModel<float, 2, 2, ShapeFunction<rbf::WendlandC4>>;
+template class GeometryModel<double, 2, 2, ShapeFunction<rbf::WendlandC4>>;
+template class GeometryModel<float, 2, 1, ShapeFunction<rbf::WendlandC4>>;
+template class GeometryModel<double, 2, 1, ShapeFunction<rbf::WendlandC4>>;
+
+template class GeometryModel<float, 2, 2, MLSShapeFunction>;
+template class GeometryModel<double, 2, 2, MLSShapeFunction>;
+template class GeometryModel<float, 2, 1, MLSShapeFunction>;
+template class GeometryModel<double, 2, 1, MLSShapeFunction>;
@@ -8,7 +8,8 @@ GQLineRPIM::GQLineRPIM()
 }
 
 // Generate quadrature points 
-geom::PointCloud<double> GQLineRPIM::generate_quadrature_points(const
+template <typename T>
+geom::PointCloudSoA<T> GQLineRPIM::generate_quadrature_points(const
     Mesh2D& mesh, int evals)
 {
     // Get weights for order provided (evals)
@@ -18,7 +19,12 @@ geom::PointCloud<double> GQLineRPIM::generate_quadrature_points(const
     m_elements_num = mesh.bound_elements.size();
 
     // Initialize quadrature points container
-    geom::PointCloud<double> quadr_pts;
+    geom::PointCloudSoA<T> quadr_pts;
+    quadr_pts.reserve(m_elements_num * evals);
+
+    // Initialize cell properties
+    m_cell_properties.clear();
+    m_cell_properties.reserve(m_elements_num);
 
     // Initialize quadrature point counter
     size_t quadr_counter = 0;
@@ -47,9 +53,6 @@ geom::PointCloud<double> GQLineRPIM::generate_quadrature_points(const
             pow(y2_i - y1_i, 2.0));
         cell_props.length = ls;
 
-        // Initialize internal vector
-        std::vector<arma::dvec> xk_vec;
-
         for (size_t k = 0; k < evals; k++)
         {
             double ksi_k = m_points_container.at(evals-1).at(k);
@@ -58,15 +61,9 @@ geom::PointCloud<double> GQLineRPIM::generate_quadrature_points(const
             double xk_i = (x2_i - x1_i) * ksi_k / 2.0 + (x1_i + x2_i) / 2.0;
             double yk_i = (y2_i - y1_i) * ksi_k / 2.0 + (y1_i + y2_i) / 2.0;
 
-            // Map integration points
-            arma::dvec xk_i_vec = arma::dvec({xk_i, yk_i});
-
-            // Push xk_i_vec to quadrature points
-            xk_vec.push_back(xk_i_vec);
-
             // Generate quadrature points point cloud
-            geom::Point<double> point_i{xk_i_vec(0), xk_i_vec(1), 0.0};
-            quadr_pts.pts.push_back(point_i);
+            geom::Point<double> point_i{xk_i, yk_i, 0.0};
+            quadr_pts.push_back(point_i);
 
             // Push back quadrature index
             cell_props.quadr_pt_idx.push_back(quadr_counter);
@@ -76,18 +73,21 @@ geom::PointCloud<double> GQLineRPIM::generate_quadrature_points(const
         }
 
         // Push quadrature indices to structure
-        m_cell_properties.push_back(cell_props);
-
-        // Push xk_vec to quadrature points container
-        m_quadrature_pts.push_back(xk_vec);
+        m_cell_properties.push_back(std::move(cell_props));
     }
 
     return quadr_pts;
 }
 
+// Explicit instantiations
+template geom::PointCloudSoA<float>
+    GQLineRPIM::generate_quadrature_points<float>(const Mesh2D&, int);
+template geom::PointCloudSoA<double>
+    GQLineRPIM::generate_quadrature_points<double>(const Mesh2D&, int);
+
 // Get quadrature indices structure
-std::vector<GQLineRPIM::CellProperties>
-    GQLineRPIM::get_integration_cells_properties(void)
+const std::vector<GQLineRPIM::CellProperties>&
+    GQLineRPIM::get_integration_cells_properties(void) const
 {
     return m_cell_properties;
 }
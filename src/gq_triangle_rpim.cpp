@@ -9,13 +9,15 @@ GQTriangleRPIM::GQTriangleRPIM()
 
 
 // Generate quadrature points 
-geom::PointCloud<double> GQTriangleRPIM::generate_quadrature_points(const
+template <typename T>
+geom::PointCloudSoA<T> GQTriangleRPIM::generate_quadrature_points(const
     Mesh2D& mesh, int order)
 {
     // Get weights and points for the order provided
     m_wps = m_wp.at(order);
 
     // Get quadrature weights
+    m_weights.clear();
     for (size_t i = 0; i < m_wps.weight.size(); i++)
     {
         m_weights.push_back(m_wps.weight.at(i).wi);
@@ -25,7 +27,12 @@ geom::PointCloud<double> GQTriangleRPIM::generate_quadrature_points(const
     m_elements_num = mesh.volume_elements.size();
 
     // Initialize quadrature points container
-    geom::PointCloud<double> quadr_pts;
+    geom::PointCloudSoA<T> quadr_pts;
+    quadr_pts.reserve(m_elements_num * m_wps.weight.size());
+
+    // Initialize cell properties
+    m_cell_properties.clear();
+    m_cell_properties.reserve(m_elements_num);
 
     // Initialize quadrature point counter
     size_t quadr_counter = 0;
@@ -64,9 +71,6 @@ geom::PointCloud<double> GQTriangleRPIM::generate_quadrature_points(const
         arma::dmat ju_i = {{(x1_i - x3_i), (x2_i - x3_i)},
             {(y1_i - y3_i), (y2_i - y3_i)}};
 
-        // Initialize internal vector
-        std::vector<arma::dvec> xk_vec;
-
         for (size_t k = 0; k < m_wps.weight.size(); k++)
         {
             // Get integration points 
@@ -75,12 +79,9 @@ geom::PointCloud<double> GQTriangleRPIM::generate_quadrature_points(const
             // Map integration points
             arma::dvec xk_i_vec = x3_i_vec + ju_i * uk;
 
-            // Push xk_i_vec to quadrature points
-            xk_vec.push_back(xk_i_vec);
-
             // Generate quadrature points point cloud
             geom::Point<double> point_i{xk_i_vec(0), xk_i_vec(1), 0.0};
-            quadr_pts.pts.push_back(point_i);
+            quadr_pts.push_back(point_i);
 
             // Push back quadrature index
             cell_props.quadr_pt_idx.push_back(quadr_counter);
@@ -90,18 +91,21 @@ geom::PointCloud<double> GQTriangleRPIM::generate_quadrature_points(const
         }
 
         // Push quadrature indices to structure
-        m_cell_properties.push_back(cell_props);
-
-        // Push xk_vec to quadrature points container
-        m_quadrature_pts.push_back(xk_vec);
+        m_cell_properties.push_back(std::move(cell_props));
     }
     
     return quadr_pts;
 }
 
+// Explicit instantiations
+template geom::PointCloudSoA<float>
+    GQTriangleRPIM::generate_quadrature_points<float>(const Mesh2D&, int);
+template geom::PointCloudSoA<double>
+    GQTriangleRPIM::generate_quadrature_points<double>(const Mesh2D&, int);
+
 // Get quadrature indices structure
-std::vector<GQTriangleRPIM::CellProperties>
-    GQTriangleRPIM::get_integration_cells_properties(void)
+const std::vector<GQTriangleRPIM::CellProperties>&
+    GQTriangleRPIM::get_integration_cells_properties(void) const
 {
     return m_cell_properties;
 }
@@ -1,20 +1,27 @@
 #include "./loading_conditions.h"
 
 // External force function
-arma::dvec LoadingConditions::external_force_function(const arma::dvec& x,
+template <size_t Dofs>
+arma::dvec LoadingConditions<Dofs>::external_force_function(const arma::dvec& x,
     const arma::dvec& q_bar)
 {
-    arma::dvec fb = {0.0, 0.0};
+    arma::dvec fb = arma::zeros<arma::dvec>(Dofs);
 
     return fb;
 }
     
 // External traction function
-arma::dvec LoadingConditions::external_traction_function(const arma::dvec& x, const
-    arma::dvec& ej)
+template <size_t Dofs>
+arma::dvec LoadingConditions<Dofs>::external_traction_function(const arma::dvec& x,
+    const arma::dvec& ej)
 {
-    // Initialize traction
-    arma::dvec to = {0.0, 0.0};
+    // Initialize traction (no flux for scalar fields)
+    arma::dvec to = arma::zeros<arma::dvec>(Dofs);
+
+    if constexpr (Dofs == 1)
+    {
+        return to;
+    }
     
     double d = 12.0; 
     double p = -5.0e5;
@@ -29,3 +36,6 @@ arma::dvec LoadingConditions::external_traction_function(const arma::dvec& x, co
     return to;
 }
 
+// Explicit instantiations
+template class LoadingConditions<2>;
+template class LoadingConditions<1>;
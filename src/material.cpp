@@ -17,4 +17,33 @@ arma::dmat Material::get_elasticity_matrix(void)
     d_matrix *= epsilon / (1.0 - pow(gamma, 2.0));
 
     return d_matrix;
-}
\ No newline at end of file
+}
+
+arma::dmat Material::get_conductivity_matrix(size_t dim)
+{
+    // Benchmark material
+    // Thermal conductivity (W / m K)
+    double kappa = 1.0;
+
+    return kappa * arma::eye<arma::dmat>(dim, dim);
+}
+
+template <size_t Dim, size_t Dofs>
+arma::dmat Material::get_constitutive_matrix(void)
+{
+    if constexpr (Dofs == 1)
+    {
+        return get_conductivity_matrix(Dim);
+    }
+    else
+    {
+        static_assert(Dim == 2 && Dofs == 2, "Elasticity is only available "
+            "in plane stress");
+
+        return get_elasticity_matrix();
+    }
+}
+
+// Explicit instantiations
+template arma::dmat Material::get_constitutive_matrix<2, 2>(void);
+template arma::dmat Material::get_constitutive_matrix<2, 1>(void);
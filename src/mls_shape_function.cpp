@@ -0,0 +1,167 @@
+#include "../include/mls_shape_function.h"
+
+
+MLSShapeFunction::MLSShapeFunction(double ac, double dc, double, int)
+{
+    // Get shape function constants
+    m_dc = dc;
+    set_shape_constant(ac);
+}
+
+// Set shape constant
+void MLSShapeFunction::set_shape_constant(double ac)
+{
+    m_ac = ac;
+
+    // Weight radius; support domain search radius for ac = as
+    double rw = 0.5 * ac * m_dc;
+    m_inv_rw2 = 1.0 / (rw * rw);
+}
+
+// Calculate
+template <typename T>
+void MLSShapeFunction::calculate(const arma::dvec& x,
+    const geom::PointSetView<T>& sup_dom, Measures& phis_str, const size_t*)
+{
+    // Number of sample points
+    size_t ns = sup_dom.size();
+
+    m_ws.u.resize(ns); m_ws.v.resize(ns);
+    m_ws.w.resize(ns); m_ws.dw_dx.resize(ns); m_ws.dw_dy.resize(ns);
+
+    double* u = m_ws.u.data();
+    double* v = m_ws.v.data();
+    double* w = m_ws.w.data();
+    double* dw_dx = m_ws.dw_dx.data();
+    double* dw_dy = m_ws.dw_dy.data();
+
+    const double px = x(0), py = x(1);
+    const double inv_dc = 1.0 / m_dc;
+    const double inv_rw2 = m_inv_rw2;
+
+    /* Quartic spline weights w = (1 - s)_+^3 (1 + 3 s), s = r / rw, and their
+    gradients dw/dx = -12 (1 - s)_+^2 (x - x_i) / rw^2 */
+    #pragma omp simd
+    for (size_t i = 0; i < ns; i++)
+    {
+        double d1 = px - (double) sup_dom.x[i];
+        double d2 = py - (double) sup_dom.y[i];
+        double s = std::sqrt((d1 * d1 + d2 * d2) * inv_rw2);
+        double t = std::max(1.0 - s, 0.0);
+        double g = -12.0 * t * t * inv_rw2;
+
+        u[i] = -d1 * inv_dc;
+        v[i] = -d2 * inv_dc;
+        w[i] = t * t * t * (1.0 + 3.0 * s);
+        dw_dx[i] = g * d1;
+        dw_dy[i] = g * d2;
+    }
+
+    /* Moment matrix A = sum_i w_i p_i p_i^T with p_i = [1, u_i, v_i], and its
+    derivatives (only the weights depend on x in the local basis) */
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double x00 = 0, x01 = 0, x02 = 0, x11 = 0, x12 = 0, x22 = 0;
+    double y00 = 0, y01 = 0, y02 = 0, y11 = 0, y12 = 0, y22 = 0;
+
+    #pragma omp simd reduction(+:a00,a01,a02,a11,a12,a22,x00,x01,x02,x11,x12,x22,y00,y01,y02,y11,y12,y22)
+    for (size_t i = 0; i < ns; i++)
+    {
+        double uu = u[i] * u[i], uv = u[i] * v[i], vv = v[i] * v[i];
+
+        a00 += w[i]; a01 += w[i] * u[i]; a02 += w[i] * v[i];
+        a11 += w[i] * uu; a12 += w[i] * uv; a22 += w[i] * vv;
+
+        x00 += dw_dx[i]; x01 += dw_dx[i] * u[i]; x02 += dw_dx[i] * v[i];
+        x11 += dw_dx[i] * uu; x12 += dw_dx[i] * uv; x22 += dw_dx[i] * vv;
+
+        y00 += dw_dy[i]; y01 += dw_dy[i] * u[i]; y02 += dw_dy[i] * v[i];
+        y11 += dw_dy[i] * uu; y12 += dw_dy[i] * uv; y22 += dw_dy[i] * vv;
+    }
+
+    arma::mat::fixed<basis_size, basis_size> a_mat = {
+        {a00, a01, a02}, {a01, a11, a12}, {a02, a12, a22}};
+    arma::mat::fixed<basis_size, basis_size> ax_mat = {
+        {x00, x01, x02}, {x01, x11, x12}, {x02, x12, x22}};
+    arma::mat::fixed<basis_size, basis_size> ay_mat = {
+        {y00, y01, y02}, {y01, y11, y12}, {y02, y12, y22}};
+
+    /* gamma = A^-1 p(x) with p(x) = [1, 0, 0] in the local basis, and its
+    derivatives dgamma/dx_k = A^-1 (dp/dx_k - dA/dx_k gamma) */
+    arma::vec::fixed<basis_size> gamma = {1.0, 0.0, 0.0};
+    arma::mat::fixed<basis_size, dim> dgamma;
+
+    arma::mat::fixed<basis_size, basis_size> ldl_mat = a_mat;
+    bool factorised = dense::ldlt_factorise(ldl_mat, basis_size);
+
+    if (factorised)
+    {
+        dense::ldlt_solve(ldl_mat, basis_size, gamma);
+    }
+    else
+    {
+        // Degenerate support (e.g. collinear nodes); least squares solution
+        ldl_mat = arma::pinv(a_mat);
+        gamma = ldl_mat.col(0);
+    }
+
+    dgamma.col(0) = -ax_mat * gamma;
+    dgamma.col(1) = -ay_mat * gamma;
+    dgamma.at(1, 0) += inv_dc;
+    dgamma.at(2, 1) += inv_dc;
+
+    if (factorised)
+    {
+        dense::ldlt_solve(ldl_mat, basis_size, dgamma);
+    }
+    else
+    {
+        dgamma = ldl_mat * dgamma;
+    }
+
+    // Initialize measures stucture
+    phis_str.phis_vec.set_size(ns);
+    phis_str.phis_jac.set_size(ns, dim);
+
+    double* phi = phis_str.phis_vec.memptr();
+    double* dphi_dx = phis_str.phis_jac.colptr(0);
+    double* dphi_dy = phis_str.phis_jac.colptr(1);
+
+    const double g0 = gamma(0), g1 = gamma(1), g2 = gamma(2);
+    const double gx0 = dgamma(0, 0), gx1 = dgamma(1, 0), gx2 = dgamma(2, 0);
+    const double gy0 = dgamma(0, 1), gy1 = dgamma(1, 1), gy2 = dgamma(2, 1);
+
+    /* phi_i = w_i gamma^T p_i;
+    dphi_i/dx_k = w_i dgamma/dx_k^T p_i + dw_i/dx_k gamma^T p_i */
+    #pragma omp simd
+    for (size_t i = 0; i < ns; i++)
+    {
+        double gp = g0 + g1 * u[i] + g2 * v[i];
+
+        phi[i] = w[i] * gp;
+        dphi_dx[i] = w[i] * (gx0 + gx1 * u[i] + gx2 * v[i]) + dw_dx[i] * gp;
+        dphi_dy[i] = w[i] * (gy0 + gy1 * u[i] + gy2 * v[i]) + dw_dy[i] * gp;
+    }
+}
+
+// Calculate a group of points
+template <typename T>
+void MLSShapeFunction::calculate_batch(const T* xs, const T* ys,
+    const geom::PointSetView<T>* sup_doms, size_t count, Measures* phis_strs)
+{
+    // The cost is linear in ns; the points are calculated one at a time
+    for (size_t p = 0; p < count; p++)
+    {
+        arma::vec::fixed<dim> x = {(double) xs[p], (double) ys[p]};
+        calculate(x, sup_doms[p], phis_strs[p]);
+    }
+}
+
+// Explicit instantiations
+template void MLSShapeFunction::calculate<float>(const arma::dvec&,
+    const geom::PointSetView<float>&, Measures&, const size_t*);
+template void MLSShapeFunction::calculate<double>(const arma::dvec&,
+    const geom::PointSetView<double>&, Measures&, const size_t*);
+template void MLSShapeFunction::calculate_batch<float>(const float*, const float*,
+    const geom::PointSetView<float>*, size_t, Measures*);
+template void MLSShapeFunction::calculate_batch<double>(const double*, const double*,
+    const geom::PointSetView<double>*, size_t, Measures*);
@@ -1,13 +1,11 @@
 #include "../include/pointcloud_rpim.h"
 
-void PointcloudRPIM::initialize(const Mesh2D& field_nodes_mesh,
+template <typename T>
+void PointcloudRPIM<T>::initialize(const Mesh2D& field_nodes_mesh,
     size_t volume_quadr_interp, size_t surface_quadr_interp)
 {
-    // Get field nodes mesh
-    m_field_nodes_mesh = field_nodes_mesh;
-
     // Get number of field nodes
-    m_field_nodes_num = m_field_nodes_mesh.node_coords.pts.size();
+    m_field_nodes_num = field_nodes_mesh.node_coords.pts.size();
 
     // Get volume quadrature interpolation number
     m_volume_quadr_interp = volume_quadr_interp;
@@ -16,23 +14,30 @@ void PointcloudRPIM::initialize(const Mesh2D& field_nodes_mesh,
     m_surface_quadr_interp = surface_quadr_interp;
     
     // Generate volume quadrature points
-    generate_volume_quadrature_points();
+    geom::PointCloudSoA<T> volume_gq_pts =
+        m_volume_gq.template generate_quadrature_points<T>(field_nodes_mesh,
+        m_volume_quadr_interp);
     
     // Generate surface quadrature points
-    generate_surface_quadrature_points();
+    geom::PointCloudSoA<T> surface_gq_pts =
+        m_surface_gq.template generate_quadrature_points<T>(field_nodes_mesh,
+        m_surface_quadr_interp);
 
     // Get the number of volume quadrature points
-    m_volume_gq_pts_num = m_volume_gq_pts.pts.size();
+    m_volume_gq_pts_num = volume_gq_pts.size();
 
     // Get the number of surface quadrature points
-    m_surface_gq_pts_num = m_surface_gq_pts.pts.size();
+    m_surface_gq_pts_num = surface_gq_pts.size();
 
     // Generate data points structure
-    generate_data_points();
+    generate_data_points(field_nodes_mesh, volume_gq_pts, surface_gq_pts);
 }
 
 // Generate data points structure
-void PointcloudRPIM::generate_data_points(void)
+template <typename T>
+void PointcloudRPIM<T>::generate_data_points(const Mesh2D& field_nodes_mesh,
+    const geom::PointCloudSoA<T>& volume_gq_pts,
+    const geom::PointCloudSoA<T>& surface_gq_pts)
 {
     /****************** Construct global data container *************************/
     // Global points number
@@ -43,56 +48,24 @@ void PointcloudRPIM::generate_data_points(void)
     quadrature_points_check();
 
     // Clear previous values and empty memory
-    m_cloud.pts.clear();
+    m_cloud.clear();
 
     // Reserve values and insert data points
-    m_cloud.pts.reserve(global_pts_num);
+    m_cloud.reserve(global_pts_num);
 
     // Append field nodes
-    m_cloud.pts.insert(m_cloud.pts.end(),
-        m_field_nodes_mesh.node_coords.pts.begin(),
-        m_field_nodes_mesh.node_coords.pts.end());
+    m_cloud.append(field_nodes_mesh.node_coords);
         
     // Append volumes's quadrature points
-    m_cloud.pts.insert(m_cloud.pts.end(), m_volume_gq_pts.pts.begin(),
-        m_volume_gq_pts.pts.end());
+    m_cloud.append(volume_gq_pts);
 
     // Append surface's quadrature points
-    m_cloud.pts.insert(m_cloud.pts.end(), m_surface_gq_pts.pts.begin(),
-        m_surface_gq_pts.pts.end());
-}
-
-
-// Generate triangle quadrature points
-void PointcloudRPIM::generate_volume_quadrature_points(void)
-{
-    // Get quadrature points for volume elements
-    m_volume_gq_pts = m_volume_gq.generate_quadrature_points(m_field_nodes_mesh,
-        m_volume_quadr_interp);
-
-    // Get volume cell properties
-    m_volume_cell_props = m_volume_gq.get_integration_cells_properties();
-
-    // Get volume cell quadrature weights
-    m_volume_cell_quadr_weights = m_volume_gq.get_quadrature_weights();
-}
-
-// Generate triagle quadrature points
-void PointcloudRPIM::generate_surface_quadrature_points(void)
-{
-    // Get quadrature points for surface elements
-    m_surface_gq_pts = m_surface_gq.generate_quadrature_points(m_field_nodes_mesh,
-        m_surface_quadr_interp);
-
-    // Get surface cell properties
-    m_surface_cells_props = m_surface_gq.get_integration_cells_properties();
-
-    // Get surface cell quadrature weights
-    m_surface_cell_quadr_weights = m_surface_gq.get_quadrature_weights();
+    m_cloud.append(surface_gq_pts);
 }
 
 // Quadrature point check
-void PointcloudRPIM::quadrature_points_check(void)
+template <typename T>
+void PointcloudRPIM<T>::quadrature_points_check(void)
 {
     // Total number of field nodes
     double field_nodes_pts = (double) m_field_nodes_num;
@@ -115,27 +88,37 @@ void PointcloudRPIM::quadrature_points_check(void)
 }
 
 // Get quadrature properties background volume cell 
-std::vector<GQTriangleRPIM::CellProperties>
-    PointcloudRPIM::get_quadrature_volume_cells_properties(void)
+template <typename T>
+const std::vector<GQTriangleRPIM::CellProperties>&
+    PointcloudRPIM<T>::get_quadrature_volume_cells_properties(void) const
 {
-    return m_volume_cell_props;
+    return m_volume_gq.get_integration_cells_properties();
 }
 
 // Get quadrature weights of background volume cell
-std::vector<double> PointcloudRPIM::get_quadrature_volume_cells_weights(void)
+template <typename T>
+const std::vector<double>&
+    PointcloudRPIM<T>::get_quadrature_volume_cells_weights(void) const
 {
-    return m_volume_cell_quadr_weights;
+    return m_volume_gq.get_quadrature_weights();
 }
 
 // Get quadrature properties background surface cell 
-std::vector<GQLineRPIM::CellProperties>
-    PointcloudRPIM::get_quadrature_surface_cells_properties(void)
+template <typename T>
+const std::vector<GQLineRPIM::CellProperties>&
+    PointcloudRPIM<T>::get_quadrature_surface_cells_properties(void) const
 {
-    return m_surface_cells_props;
+    return m_surface_gq.get_integration_cells_properties();
 }
 
 // Get quadrature weights of background surface cell
-std::vector<double> PointcloudRPIM::get_quadrature_surface_cells_weights(void)
+template <typename T>
+const std::vector<double>&
+    PointcloudRPIM<T>::get_quadrature_surface_cells_weights(void) const
 {
-    return m_surface_cell_quadr_weights;
-}
\ No newline at end of file
+    return m_surface_gq.get_quadrature_weights();
+}
+
+// Explicit instantiations
+template class PointcloudRPIM<float>;
+template class PointcloudRPIM<double>;
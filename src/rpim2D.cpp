@@ -1,6 +1,7 @@
 #include "../include/rpim2D.h"
 
-void RPIM2D::initialize(const Mesh2D& mesh_raw, double thickness,
+template <typename T>
+void RPIM2D<T>::initialize(const Mesh2D& mesh_raw, double thickness,
     const geom::RPIMParameters& params, bool animate)
 {
     // Set search params 
@@ -16,8 +17,8 @@ void RPIM2D::initialize(const Mesh2D& mesh_raw, double thickness,
     m_thickness = thickness;
 
     // Get field nodes mesh mesh
-    m_field_nodes_mesh = bc.get_mesh();
-    m_field_nodes_mesh_initial = m_field_nodes_mesh;
+    m_field_nodes_mesh_initial = bc.get_mesh();
+    m_field_nodes_mesh = m_field_nodes_mesh_initial;
     
     // Get number of boundaries
     m_boundaries_num = bc.get_number_of_boundaries();
@@ -32,65 +33,485 @@ void RPIM2D::initialize(const Mesh2D& mesh_raw, double thickness,
     m_point_load.initialize(m_field_nodes_mesh_initial);
 
     // Generate pointcloud for rpim 
-    m_pc_rpim.initialize(m_field_nodes_mesh, m_volume_quadr_interp,
+    m_pc_rpim.initialize(m_field_nodes_mesh_initial, m_volume_quadr_interp,
         m_surface_quadr_interp);
 
-    // Get cloud
+    // Get cloud (current configuration)
     m_cloud = m_pc_rpim.get_cloud();
-    m_cloud_initial = m_cloud;
 
-    // Set quadrature properties of background volume cell
-    m_volume_cell_props = m_pc_rpim.get_quadrature_volume_cells_properties();
+    /* Total Lagrangian formulation; the support domains are generated once in
+    the reference configuration */
+    if (m_search_params.total_lagrangian || m_search_params.tune_shape_constant)
+    {
+        m_sup_domain.generate(m_cloud, m_field_nodes_num, m_search_params,
+            m_sup_domain_table, m_animation_flag);
+    }
+
+    // Shape constant keeping the reference Gs matrices conditioned
+    if (m_search_params.tune_shape_constant)
+    {
+        ShapeTunerSettings settings;
+        settings.max_condition = m_search_params.max_condition;
+
+        ShapeTuner<T> shape_tuner(m_search_params, m_search_params.ms,
+            settings);
+        m_search_params.ac = shape_tuner.tune(m_sup_domain_table);
+    }
 
-    // Set quadrature weights of background volume cell
-    m_volume_cell_quadr_weights = m_pc_rpim.get_quadrature_volume_cells_weights();
+    // Geometry models, one per thread (they reference the support domain table)
+    m_geom_models.resize(assembly::max_threads());
+    for (size_t t = 0; t < m_geom_models.size(); t++)
+    {
+        m_geom_models[t] = std::make_unique<GeometryModel<T, m_dim,
+            m_dofs_per_node>>(m_sup_domain_table, m_search_params);
+
+        // The precomputed shape functions are held by the first model
+        if (t > 0)
+        {
+            m_geom_models[t]->share_shape_functions(*m_geom_models[0]);
+        }
+    }
+
+    // Quadrature points of the background cells
+    set_quadrature_points();
 
-    // Set quadrature properties of background surface cell
-    m_surface_cell_props = m_pc_rpim.get_quadrature_surface_cells_properties();
+    // Shape functions of the reference configuration; computed once
+    if (m_search_params.total_lagrangian)
+    {
+        m_geom_models[0]->precompute_shape_functions();
 
-    // Set quadrature weights of background volume cell
-    m_surface_cell_quadr_weights = m_pc_rpim.get_quadrature_surface_cells_weights();
+        // Stiffness and external forces of the reference configuration
+        assemble(arma::zeros<arma::dvec>(m_dofs_num));
+    }
 }
 
 // Update field nodes
-void RPIM2D::update(const arma::dvec& q_bar)
+template <typename T>
+void RPIM2D<T>::update(const arma::dvec& q_bar)
 {   
     // Update field nodes mesh and cloud
     update_field_nodes_mesh_and_cloud(q_bar);
 
+    // Total Lagrangian; the reference support domains, shape functions and
+    // stiffness are reused, the loads are evaluated in the current state
+    if (m_search_params.total_lagrangian)
+    {
+        assemble(q_bar, false);
+        return;
+    }
+
     // Generate support domain structure
-    auto sup_domain_pts = m_sup_domain.generate(m_field_nodes_mesh.node_coords,
-        m_cloud, m_search_params, m_animation_flag);
+    m_sup_domain.generate(m_cloud, m_field_nodes_num, m_search_params,
+        m_sup_domain_table, m_animation_flag);
+
+    // Stiffness and external forces of the current configuration
+    assemble(q_bar);
 }    
 
+// Set quadrature points
+template <typename T>
+void RPIM2D<T>::set_quadrature_points(void)
+{
+    // Volume cells; their points lead the support domain table
+    const std::vector<GQTriangleRPIM::CellProperties>& volume_cells =
+        m_pc_rpim.get_quadrature_volume_cells_properties();
+    const std::vector<double>& volume_weights =
+        m_pc_rpim.get_quadrature_volume_cells_weights();
+
+    m_volume_points.clear();
+    for (const GQTriangleRPIM::CellProperties& cell_props : volume_cells)
+    {
+        for (size_t k = 0; k < cell_props.quadr_pt_idx.size(); k++)
+        {
+            m_volume_points.push_back({cell_props.quadr_pt_idx.at(k),
+                volume_weights.at(k) * cell_props.area * m_thickness});
+        }
+    }
+
+    // Surface cells (half lengths); their points follow the volume ones
+    const std::vector<GQLineRPIM::CellProperties>& surface_cells =
+        m_pc_rpim.get_quadrature_surface_cells_properties();
+    const std::vector<double>& surface_weights =
+        m_pc_rpim.get_quadrature_surface_cells_weights();
+    size_t volume_pts_num = m_pc_rpim.get_number_of_volume_quadrature_points();
+
+    m_surface_points.clear();
+    for (const GQLineRPIM::CellProperties& cell_props : surface_cells)
+    {
+        for (size_t k = 0; k < cell_props.quadr_pt_idx.size(); k++)
+        {
+            m_surface_points.push_back({volume_pts_num + cell_props.quadr_pt_idx.at(k),
+                surface_weights.at(k) * cell_props.length * m_thickness});
+        }
+    }
+}
+
+// Colour quadrature points
+template <typename T>
+void RPIM2D<T>::colour_quadrature_points(void)
+{
+    m_volume_colours = assembly::colour_points<T>(m_sup_domain_table,
+        m_volume_points, m_field_nodes_num);
+    m_surface_colours = assembly::colour_points<T>(m_sup_domain_table,
+        m_surface_points, m_field_nodes_num);
+
+    m_colours_version = m_sup_domain_table.pattern_version;
+}
+
+// Assemble stiffness and external forces
+template <typename T>
+void RPIM2D<T>::assemble(const arma::dvec& q_bar, bool stiffness)
+{
+    // Patterns and slot map of the current support domains
+    if (m_k_values.empty() || m_pattern_version != m_sup_domain_table.pattern_version)
+    {
+        assemble_symbolic();
+    }
+
+    // One geometry model per thread
+    size_t threads_num = m_geom_models.size();
+
+    if (m_search_params.assembly == geom::AssemblyStrategy::COLOURING)
+    {
+        // Colours of the current support domains
+        if (m_volume_colours.empty() || m_colours_version != m_sup_domain_table.pattern_version)
+        {
+            colour_quadrature_points();
+        }
+
+        // Shared storage (no stiffness values for the forces only)
+        double* k_values = stiffness ? m_k_values[0].data() : nullptr;
+        arma::dvec& fex = m_f_values[0];
+        if (stiffness)
+        {
+            std::fill(m_k_values[0].begin(), m_k_values[0].end(), 0.0);
+        }
+        fex.zeros();
+
+        #pragma omp parallel num_threads(threads_num)
+        {
+            GeometryModel<T, m_dim, m_dofs_per_node>& geom_model =
+                *m_geom_models[assembly::thread_num()];
+
+            // The points of a colour touch disjoint dofs (rows of K); the
+            // colours are assembled one after the other (barrier at the end of
+            // each loop)
+            for (const std::vector<size_t>& colour : m_volume_colours)
+            {
+                #pragma omp for schedule(dynamic, 16)
+                for (size_t k = 0; k < colour.size(); k++)
+                {
+                    size_t p = colour[k];
+                    volume_point_contributions(geom_model, m_volume_points[p], q_bar,
+                        m_k_slot_map.data() + m_volume_slots[p], k_values, fex);
+                }
+            }
+
+            for (const std::vector<size_t>& colour : m_surface_colours)
+            {
+                #pragma omp for schedule(dynamic, 16)
+                for (size_t k = 0; k < colour.size(); k++)
+                {
+                    surface_point_contributions(geom_model,
+                        m_surface_points[colour[k]], q_bar, fex);
+                }
+            }
+        }
+    }
+    else
+    {
+        // Threads granted to the region; only their buffers are written
+        size_t team_num = 1;
+
+        #pragma omp parallel num_threads(threads_num)
+        {
+            #pragma omp single
+            team_num = assembly::team_size();
+
+            size_t t = assembly::thread_num();
+            GeometryModel<T, m_dim, m_dofs_per_node>& geom_model = *m_geom_models[t];
+
+            // Thread local storage (no stiffness values for the forces only)
+            double* k_values = stiffness ? m_k_values[t].data() : nullptr;
+            arma::dvec& fex = m_f_values[t];
+            if (stiffness)
+            {
+                std::fill(m_k_values[t].begin(), m_k_values[t].end(), 0.0);
+            }
+            fex.zeros();
+
+            #pragma omp for schedule(dynamic, 16) nowait
+            for (size_t p = 0; p < m_volume_points.size(); p++)
+            {
+                volume_point_contributions(geom_model, m_volume_points[p], q_bar,
+                    m_k_slot_map.data() + m_volume_slots[p], k_values, fex);
+            }
+
+            #pragma omp for schedule(dynamic, 16)
+            for (size_t p = 0; p < m_surface_points.size(); p++)
+            {
+                surface_point_contributions(geom_model, m_surface_points[p],
+                    q_bar, fex);
+            }
+
+            // Merge the thread contributions into the first buffers
+            size_t values_num = stiffness ? m_k_values[0].size() : 0;
+
+            #pragma omp for schedule(static)
+            for (size_t k = 0; k < values_num; k++)
+            {
+                for (size_t u = 1; u < team_num; u++)
+                {
+                    m_k_values[0][k] += m_k_values[u][k];
+                }
+            }
+        }
+
+        for (size_t t = 1; t < team_num; t++)
+        {
+            m_f_values[0] += m_f_values[t];
+        }
+    }
+
+    // Values of the blocks
+    if (stiffness)
+    {
+        const double* k_values = m_k_values[0].data();
+        for (BSRMatrix* block : {&m_kfcc, &m_kfca, &m_kfaa})
+        {
+            std::copy_n(k_values, block->values().size(), block->values().begin());
+            k_values += block->values().size();
+        }
+    }
+
+    // Boundary-first partition of the external forces (and point loads)
+    arma::dvec fex = m_f_values[0] + m_point_load.get_point_loads(q_bar);
+
+    size_t dofs_c = m_dofs_per_node * m_boundaries_num;
+    m_fex_c = fex.rows(0, dofs_c - 1);
+    m_fex_a = fex.rows(dofs_c, m_dofs_num - 1);
+}
+
+// Symbolic assembly
+template <typename T>
+void RPIM2D<T>::assemble_symbolic(void)
+{
+    const typename SupportDomain<T>::SupportDomainTable& sd_table =
+        m_sup_domain_table;
+
+    // Nodes coupled to each node (sharing the support domain of a volume point)
+    std::vector<std::vector<size_t>> adjacency(m_field_nodes_num);
+    for (const assembly::QuadraturePoint& pt : m_volume_points)
+    {
+        const size_t* first = sd_table.support_indices.data() + sd_table.offsets[pt.idx];
+        const size_t* last = sd_table.support_indices.data() + sd_table.offsets[pt.idx + 1];
+
+        for (const size_t* node = first; node != last; node++)
+        {
+            adjacency[*node].insert(adjacency[*node].end(), first, last);
+        }
+    }
+
+    for (std::vector<size_t>& nodes : adjacency)
+    {
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    }
+
+    /* Pattern of the block of the nodes [row_first, row_last) x [col_first,
+    col_last); upper block triangle if symmetric */
+    auto set_block_pattern = [&](BSRMatrix& block, size_t row_first,
+        size_t row_last, size_t col_first, size_t col_last, bool symmetric)
+    {
+        std::vector<BSRMatrix::Index> row_ptr = {0}, col_idx;
+        for (size_t i = row_first; i < row_last; i++)
+        {
+            auto first = std::lower_bound(adjacency[i].begin(), adjacency[i].end(),
+                symmetric ? i : col_first);
+            auto last = std::lower_bound(first, adjacency[i].end(), col_last);
+
+            for (auto j = first; j != last; j++)
+            {
+                col_idx.push_back(*j - col_first);
+            }
+            row_ptr.push_back(col_idx.size());
+        }
+
+        block.set_pattern(row_last - row_first, col_last - col_first,
+            std::move(row_ptr), std::move(col_idx), symmetric);
+    };
+
+    // The constrained nodes lead (boundary-first partition)
+    size_t nodes_c = m_boundaries_num;
+    set_block_pattern(m_kfcc, 0, nodes_c, 0, nodes_c, true);
+    set_block_pattern(m_kfca, 0, nodes_c, nodes_c, m_field_nodes_num, false);
+    set_block_pattern(m_kfaa, nodes_c, m_field_nodes_num, nodes_c,
+        m_field_nodes_num, true);
+
+    // Offsets of the blocks in the concatenated block values
+    size_t offset_ca = m_kfcc.get_blocks_num();
+    size_t offset_aa = offset_ca + m_kfca.get_blocks_num();
+    size_t blocks_num = offset_aa + m_kfaa.get_blocks_num();
+
+    // Slot map offsets of the volume points
+    m_volume_slots.resize(m_volume_points.size() + 1);
+    m_volume_slots[0] = 0;
+    for (size_t p = 0; p < m_volume_points.size(); p++)
+    {
+        size_t idx = m_volume_points[p].idx;
+        size_t ns = sd_table.offsets[idx + 1] - sd_table.offsets[idx];
+
+        m_volume_slots[p + 1] = m_volume_slots[p] + ns * ns;
+    }
+
+    // Slot map
+    m_k_slot_map.resize(m_volume_slots.back());
+
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (size_t p = 0; p < m_volume_points.size(); p++)
+    {
+        size_t idx = m_volume_points[p].idx;
+        size_t ns = sd_table.offsets[idx + 1] - sd_table.offsets[idx];
+        const size_t* support = sd_table.support_indices.data() + sd_table.offsets[idx];
+        BSRMatrix::Index* slots = m_k_slot_map.data() + m_volume_slots[p];
+
+        for (size_t j = 0; j < ns; j++)
+        {
+            size_t nj = support[j];
+            for (size_t i = 0; i < ns; i++)
+            {
+                size_t ni = support[i];
+                BSRMatrix::Index slot;
+
+                if (ni < nodes_c)
+                {
+                    slot = nj < nodes_c ? m_kfcc.slot(ni, nj) :
+                        offset_ca + m_kfca.slot(ni, nj - nodes_c);
+                }
+                else
+                {
+                    slot = nj < nodes_c ? BSRMatrix::discarded :
+                        m_kfaa.slot(ni - nodes_c, nj - nodes_c);
+
+                    if (slot != BSRMatrix::discarded)
+                    {
+                        slot += offset_aa;
+                    }
+                }
+
+                *slots++ = slot;
+            }
+        }
+    }
+
+    // Value buffers (one for the colouring)
+    size_t buffers_num = m_search_params.assembly ==
+        geom::AssemblyStrategy::COLOURING ? 1 : m_geom_models.size();
+
+    m_k_values.assign(buffers_num, std::vector<double>(BSRMatrix::block_values *
+        blocks_num));
+    m_f_values.assign(buffers_num, arma::zeros<arma::dvec>(m_dofs_num));
+
+    m_pattern_version = sd_table.pattern_version;
+}
+
+// Volume point contributions
+template <typename T>
+void RPIM2D<T>::volume_point_contributions(GeometryModel<T, m_dim,
+    m_dofs_per_node>& geom_model, const assembly::QuadraturePoint& pt,
+    const arma::dvec& q_bar, const BSRMatrix::Index* slots, double* k_values,
+    arma::dvec& fex) const
+{
+    geom_model.update(pt.idx, q_bar);
+    const std::vector<size_t>& local_dofs = geom_model.get_local_dofs();
+
+    // Local stiffness on the support domain dofs, added by node blocks
+    if (k_values)
+    {
+        geom_model.add_k_el_local(pt.weight, slots, k_values);
+    }
+
+    // Body forces
+    const arma::dvec& f_local = geom_model.f_bex_local(geom_model.get_x_interest(),
+        q_bar);
+
+    for (size_t a = 0; a < local_dofs.size(); a++)
+    {
+        fex.at(local_dofs[a]) += pt.weight * f_local.at(a);
+    }
+}
+
+// Surface point contributions
+template <typename T>
+void RPIM2D<T>::surface_point_contributions(GeometryModel<T, m_dim,
+    m_dofs_per_node>& geom_model, const assembly::QuadraturePoint& pt,
+    const arma::dvec& q_bar, arma::dvec& fex) const
+{
+    geom_model.update(pt.idx, q_bar);
+    const std::vector<size_t>& local_dofs = geom_model.get_local_dofs();
+
+    // Tractions
+    const arma::dvec& f_local = geom_model.f_tex_local(geom_model.get_x_interest(),
+        q_bar);
+
+    for (size_t a = 0; a < local_dofs.size(); a++)
+    {
+        fex.at(local_dofs[a]) += pt.weight * f_local.at(a);
+    }
+}
+
 // Update field nodes mesh
-void RPIM2D::update_field_nodes_mesh_and_cloud(const arma::dvec& q_bar)
+template <typename T>
+void RPIM2D<T>::update_field_nodes_mesh_and_cloud(const arma::dvec& q_bar)
 {
+    // Initial cloud
+    const geom::PointCloudSoA<T>& cloud_initial = get_initial_cloud();
+
     // PARALLELISE
     for (size_t i = 0; i < m_field_nodes_num; i++)
     {
         // Update field nodes sturcture 
         m_field_nodes_mesh.node_coords.pts.at(i).x = 
-            m_field_nodes_mesh_initial.node_coords.pts.at(i).x + q_bar(2*i);
+            m_field_nodes_mesh_initial.node_coords.pts.at(i).x + q_bar(m_dofs_per_node*i);
         
         m_field_nodes_mesh.node_coords.pts.at(i).y = 
-            m_field_nodes_mesh_initial.node_coords.pts.at(i).y + q_bar(2*i+1);
+            m_field_nodes_mesh_initial.node_coords.pts.at(i).y + q_bar(m_dofs_per_node*i+1);
 
         // Update cloud
-        m_cloud.pts.at(i).x = m_cloud_initial.pts.at(i).x + q_bar(2*i);
+        m_cloud.x[i] = cloud_initial.x[i] + (T) q_bar(m_dofs_per_node*i);
 
-        m_cloud.pts.at(i).y = m_cloud_initial.pts.at(i).y + q_bar(2*i+1);
+        m_cloud.y[i] = cloud_initial.y[i] + (T) q_bar(m_dofs_per_node*i+1);
     }
 }
 
+// Get factorisation cache statistics
+template <typename T>
+FactorisationCache::Stats RPIM2D<T>::get_factorisation_cache_stats(void) const
+{
+    FactorisationCache::Stats stats;
+    for (const auto& geom_model : m_geom_models)
+    {
+        const FactorisationCache::Stats& model_stats =
+            geom_model->get_factorisation_cache_stats();
+
+        stats.lookups += model_stats.lookups;
+        stats.hits += model_stats.hits;
+        stats.evictions += model_stats.evictions;
+    }
+
+    return stats;
+}
+
 // Get boundary state vector
-arma::dvec RPIM2D::get_boundary_state_vector(const arma::dvec& q_bar)
+template <typename T>
+arma::dvec RPIM2D<T>::get_boundary_state_vector(const arma::dvec& q_bar)
 {
-    return q_bar.rows(0, 2*m_boundaries_num-1);
+    return q_bar.rows(0, m_dofs_per_node*m_boundaries_num-1);
 }
 
 // Get deformed state of pointcloud of interest
-geom::PointCloud<double> RPIM2D::get_deformed_state(const
+template <typename T>
+geom::PointCloud<double> RPIM2D<T>::get_deformed_state(const
     geom::PointCloud<double>& inter_pc, const arma::dvec& q_bar) const
 {
 
@@ -98,7 +519,8 @@ geom::PointCloud<double> RPIM2D::get_deformed_state(const
     geom::PointCloud<double> final_inter_pc;  
 
     // Initiial point cloud
-    geom::PointCloud<double> field_nodes = m_field_nodes_mesh_initial.node_coords;
+    const geom::PointCloud<double>& field_nodes =
+        m_field_nodes_mesh_initial.node_coords;
 
     /****************** Construct data container *************************/
     // Global points number
@@ -106,33 +528,34 @@ geom::PointCloud<double> RPIM2D::get_deformed_state(const
         inter_pc.pts.size();
 
     // Reserve values and insert data points
-    geom::PointCloud<double> cloud;
-    cloud.pts.reserve(data_pts_num);
+    geom::PointCloudSoA<T> cloud;
+    cloud.reserve(data_pts_num);
 
     // Append field nodes
-    cloud.pts.insert(cloud.pts.end(), field_nodes.pts.begin(),
-        field_nodes.pts.end());
+    cloud.append(field_nodes);
 
     // Append interest points
-    cloud.pts.insert(cloud.pts.end(), inter_pc.pts.begin(), inter_pc.pts.end());
+    cloud.append(inter_pc);
 
     // Generate support domain structure
-    SupportDomain sup_domain;
+    SupportDomain<T> sup_domain;
+    typename SupportDomain<T>::SupportDomainTable sup_domain_table;
 
-    auto sup_domain_pts = sup_domain.generate(field_nodes, cloud,
-        m_search_params, false);
+    sup_domain.generate(cloud, field_nodes.pts.size(), m_search_params,
+        sup_domain_table, false);
 
     // Initialize geometry model
-    GeometryModel geom_model(sup_domain_pts, m_search_params);
+    GeometryModel<T, m_dim, m_dofs_per_node> geom_model(sup_domain_table, m_search_params);
 
     // Loop through interest points
+    final_inter_pc.pts.reserve(inter_pc.pts.size());
     for (size_t i = 0; i < inter_pc.pts.size(); i++)
     {
         // Update geometric model
         geom_model.update(i, q_bar);
 
         // Get deformation
-        auto deformation_arma = geom_model.get_deformation();
+        const arma::dvec& deformation_arma = geom_model.get_deformation();
 
         // Calculate deformed point
         geom::Point<double> final_point;
@@ -148,16 +571,21 @@ geom::PointCloud<double> RPIM2D::get_deformed_state(const
 }
 
 // Get deformed mesh
-Mesh2D RPIM2D::get_deformed_mesh(const arma::dvec& q_bar) const
+template <typename T>
+Mesh2D RPIM2D<T>::get_deformed_mesh(const arma::dvec& q_bar) const
 {
     // Initialize deformed mesh
     Mesh2D deformed_mesh = m_field_nodes_mesh_initial;
 
     for (size_t i = 0; i < deformed_mesh.node_coords.pts.size(); i++)
     {
-        deformed_mesh.node_coords.pts.at(i).x += q_bar(2*i);
-        deformed_mesh.node_coords.pts.at(i).y += q_bar(2*i+1);
+        deformed_mesh.node_coords.pts.at(i).x += q_bar(m_dofs_per_node*i);
+        deformed_mesh.node_coords.pts.at(i).y += q_bar(m_dofs_per_node*i+1);
         deformed_mesh.node_coords.pts.at(i).z += 0.0;
     }
     return deformed_mesh;
-}
\ No newline at end of file
+}
+
+// Explicit instantiations
+template class RPIM2D<float>;
+template class RPIM2D<double>;
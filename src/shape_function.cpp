@@ -1,168 +1,1121 @@
 #include "../include/shape_function.h"
 
+#include <type_traits>
+#include <stdexcept>
+#include <limits>
+#include <string>
 
-ShapeFunction::ShapeFunction(double ac, double dc, double q, int ms)
+
+template <typename Rbf>
+ShapeFunction<Rbf>::ShapeFunction(double ac, double dc, double q, int ms) :
+    m_rbf(ac, dc, q)
 {
+    // Linear and quadratic bases only
+    if (ms != 0 && ms != 3 && ms != 6)
+    {
+        throw std::invalid_argument("ShapeFunction: polynomial basis size ms "
+            "must be 0, 3 or 6 (got " + std::to_string(ms) + ")");
+    }
+
     // Get shape function constants
-    m_ac = ac; m_dc = dc; m_q = q; m_ms = ms;
+    m_ac = ac; m_dc = dc; m_q = q; m_ms = (size_t) ms;
+
+    // Stencil shapes are equal up to round-off of the nodal coordinates
+    m_stencil_tol = 1.0e-9 * dc;
+    m_cache.set_shape_cell(dc / 1024.0);
+}
+
+// Set stencil reuse mode
+template <typename Rbf>
+void ShapeFunction<Rbf>::set_stencil_reuse(bool stencil_reuse)
+{
+    m_stencil_reuse = stencil_reuse;
+}
+
+// Set shape constant
+template <typename Rbf>
+void ShapeFunction<Rbf>::set_shape_constant(double ac)
+{
+    m_ac = ac;
+    m_rbf = Rbf(ac, m_dc, m_q);
+
+    // The cached factors belong to the previous kernel
+    m_cache.clear();
+}
+
+// Set condition monitor
+template <typename Rbf>
+void ShapeFunction<Rbf>::set_condition_monitor(bool condition_monitor)
+{
+    // Cached factors may have no estimate
+    if (condition_monitor && !m_condition_monitor)
+    {
+        m_cache.clear();
+    }
+
+    m_condition_monitor = condition_monitor;
+}
+
+// Stencil shape tolerance
+template <typename Rbf>
+template <typename T>
+double ShapeFunction<Rbf>::stencil_tolerance(double x0, double y0) const
+{
+    // Round-off of T at the magnitude of the coordinates (support extent ~ dc)
+    double magnitude = std::max(std::abs(x0), std::abs(y0)) + m_dc;
+
+    return std::max(m_stencil_tol,
+        8.0 * std::numeric_limits<T>::epsilon() * magnitude);
+}
+
+// Record condition estimate
+template <typename Rbf>
+void ShapeFunction<Rbf>::record_condition(double cond)
+{
+    m_last_condition = cond;
+
+    m_condition_stats.count++;
+    m_condition_stats.max = std::max(m_condition_stats.max, cond);
+    m_condition_stats.sum_log10 += std::log10(cond);
+
+    if (cond > m_condition_stats.limit)
+    {
+        m_condition_stats.above_limit++;
+    }
 }
 
 
 // Calculate
-ShapeFunction::Measures ShapeFunction::calculate(const arma::dvec& x,
-    const std::vector<arma::dvec>& sup_dom)
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::calculate(const arma::dvec& x,
+    const geom::PointSetView<T>& sup_dom, Measures& phis_str,
+    const size_t* support_indices)
 {
     // Number of sample points
     size_t ns = sup_dom.size();
 
-    // Initialize measures stucture
-    Measures phis_str;
-    phis_str.phis_vec = arma::zeros<arma::dvec>(ns, 1);
-    phis_str.phis_jac = arma::zeros<arma::dmat>(ns, x.n_rows);
-    phis_str.phis_mat =  arma::zeros<arma::dmat>(x.n_rows, 2 * ns);
+    if (!m_stencil_reuse || ns == 0)
+    {
+        calculate_system(x, sup_dom, phis_str, support_indices);
+        return;
+    }
 
-    // ri and pi vectors and jacobians
-    VecJac ri_vecjac = rbf_mq(x, sup_dom);
-    VecJac pi_vecjac = polynomial2D_basis(x);
+    // Local origin; first support node
+    double x0 = (double) sup_dom.x[0];
+    double y0 = (double) sup_dom.y[0];
+
+    // Support domain in local coordinates
+    m_ws.local_x.resize(ns);
+    m_ws.local_y.resize(ns);
+    for (size_t j = 0; j < ns; j++)
+    {
+        m_ws.local_x[j] = (double) sup_dom.x[j] - x0;
+        m_ws.local_y[j] = (double) sup_dom.y[j] - y0;
+    }
+
+    geom::PointSetView<double> local_dom{m_ws.local_x.data(),
+        m_ws.local_y.data(), nullptr, ns};
+
+    // Interest point in local coordinates
+    arma::vec::fixed<dim> x_local = {x(0) - x0, x(1) - y0};
+
+    /* Evaluate on the geometry of an equal cached stencil, if any; the local
+    coordinates differ from it by round-off only */
+    m_ws.stencil_tol = stencil_tolerance<T>(x0, y0);
+    m_cache.snap(m_ws.local_x.data(), m_ws.local_y.data(), ns, m_ws.stencil_tol);
+
+    // The factors are cached by stencil shape instead of support set
+    calculate_system(x_local, local_dom, phis_str, nullptr);
+}
+
+// Calculate dispatching on the size of the gs system
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::calculate_system(const arma::dvec& x,
+    const geom::PointSetView<T>& sup_dom, Measures& phis_str,
+    const size_t* support_indices)
+{
+    // Size of the gs system
+    size_t n = sup_dom.size() + m_ms;
+
+    // Dispatch to the smallest fixed size kernel that fits (ns + ms <= 40)
+    if (n <= 16)
+    {
+        calculate_fixed<16>(x, sup_dom, phis_str, support_indices);
+    }
+    else if (n <= 24)
+    {
+        calculate_fixed<24>(x, sup_dom, phis_str, support_indices);
+    }
+    else if (n <= 32)
+    {
+        calculate_fixed<32>(x, sup_dom, phis_str, support_indices);
+    }
+    else if (n <= 40)
+    {
+        calculate_fixed<40>(x, sup_dom, phis_str, support_indices);
+    }
+    else
+    {
+        calculate_dynamic(x, sup_dom, phis_str, support_indices);
+    }
+}
+
+// Calculate with stack storage
+template <typename Rbf>
+template <size_t N, typename T>
+void ShapeFunction<Rbf>::calculate_fixed(const arma::dvec& x,
+    const geom::PointSetView<T>& sup_dom, Measures& phis_str,
+    const size_t* support_indices)
+{
+    // Padded gs matrix (built on demand) and right hand sides
+    arma::mat::fixed<N, N> gs_mat;
+    arma::mat::fixed<N, dim + 1> rhs_mat(arma::fill::zeros);
+
+    // Calculate right hand sides
+    rhs_matrix(x, sup_dom, rhs_mat);
+
+    // Solve gs * sol = rhs (rhs_mat is overwritten by the solution)
+    solve_system(sup_dom, support_indices, gs_mat, rhs_mat);
+
+    set_measures(rhs_mat, sup_dom.size(), phis_str);
+}
+
+// Calculate a group of points
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::calculate_batch(const T* xs, const T* ys,
+    const geom::PointSetView<T>* sup_doms, size_t count, Measures* phis_strs)
+{
+    // Padded system sizes of the lockstep kernels
+    const size_t sizes[] = {16, 24, 32, 40};
+
+    /* The condition monitor needs the factors of each system, and a Gs with
+    a zero diagonal always needs pivoting */
+    if (m_condition_monitor || Rbf::zero_diagonal)
+    {
+        for (size_t p = 0; p < count; p++)
+        {
+            arma::vec::fixed<dim> x = {(double) xs[p], (double) ys[p]};
+            calculate_system(x, sup_doms[p], phis_strs[p], nullptr);
+        }
+
+        return;
+    }
+
+    std::vector<size_t>& idx = m_ws.batch_idx;
+
+    for (size_t s = 0; s < 4; s++)
+    {
+        size_t n_min = (s == 0) ? 0 : sizes[s - 1] + 1;
+
+        // Points whose system pads to sizes[s]
+        idx.clear();
+        for (size_t p = 0; p < count; p++)
+        {
+            size_t n = sup_doms[p].size() + m_ms;
+
+            if (sup_doms[p].size() > 0 && n >= n_min && n <= sizes[s])
+            {
+                idx.push_back(p);
+            }
+        }
+
+        // Order by support size, so that the lanes of a batch are alike
+        std::stable_sort(idx.begin(), idx.end(), [sup_doms](size_t a, size_t b) {
+            return sup_doms[a].size() < sup_doms[b].size(); });
+
+        // Lockstep batches (twice the lanes in single precision)
+        size_t width = m_mixed_precision ? 2 * batch_width : batch_width;
+
+        for (size_t first = 0; first < idx.size(); first += width)
+        {
+            size_t lanes = std::min(width, idx.size() - first);
+
+            if (m_mixed_precision)
+            {
+                calculate_lockstep_sized<float>(sizes[s], xs, ys, sup_doms,
+                    idx.data() + first, lanes, phis_strs);
+            }
+            else
+            {
+                calculate_lockstep_sized<double>(sizes[s], xs, ys, sup_doms,
+                    idx.data() + first, lanes, phis_strs);
+            }
+        }
+    }
+
+    // Larger (and empty) support domains one at a time
+    for (size_t p = 0; p < count; p++)
+    {
+        if (sup_doms[p].size() == 0 || sup_doms[p].size() + m_ms > sizes[3])
+        {
+            arma::vec::fixed<dim> x = {(double) xs[p], (double) ys[p]};
+            calculate_system(x, sup_doms[p], phis_strs[p], nullptr);
+        }
+    }
+}
+
+// Calculate a batch of points in lockstep dispatching on the padded size
+template <typename Rbf>
+template <typename S, typename T>
+void ShapeFunction<Rbf>::calculate_lockstep_sized(size_t size, const T* xs,
+    const T* ys, const geom::PointSetView<T>* sup_doms, const size_t* idx,
+    size_t lanes, Measures* phis_strs)
+{
+    switch (size)
+    {
+        case 16:
+            calculate_lockstep<S, 16>(xs, ys, sup_doms, idx, lanes, phis_strs);
+            break;
+        case 24:
+            calculate_lockstep<S, 24>(xs, ys, sup_doms, idx, lanes, phis_strs);
+            break;
+        case 32:
+            calculate_lockstep<S, 32>(xs, ys, sup_doms, idx, lanes, phis_strs);
+            break;
+        default:
+            calculate_lockstep<S, 40>(xs, ys, sup_doms, idx, lanes, phis_strs);
+            break;
+    }
+}
+
+// Calculate a batch of points in lockstep
+template <typename Rbf>
+template <typename S, size_t N, typename T>
+void ShapeFunction<Rbf>::calculate_lockstep(const T* xs, const T* ys,
+    const geom::PointSetView<T>* sup_doms, const size_t* idx, size_t lanes,
+    Measures* phis_strs)
+{
+    // Lanes of a vector register in the factorisation scalar type
+    constexpr size_t W = batch_width * sizeof(double) / sizeof(S);
+    constexpr size_t nrhs = dim + 1;
+
+    // Size of the lockstep systems; largest system of the lanes
+    size_t n = 0;
+    for (size_t b = 0; b < lanes; b++)
+    {
+        n = std::max(n, sup_doms[idx[b]].size() + m_ms);
+    }
+
+    // Interleaved storage
+    m_ws.batch_gs.resize(n * n * W);
+    m_ws.batch_rhs.resize(n * nrhs * W);
+    double* gs = m_ws.batch_gs.data();
+    double* rhs = m_ws.batch_rhs.data();
+
+    // Systems of each lane (unused lanes hold identity systems)
+    arma::mat::fixed<N, N> gs_mat;
+    arma::mat::fixed<N, nrhs> rhs_mat;
+
+    for (size_t b = 0; b < W; b++)
+    {
+        if (b < lanes)
+        {
+            size_t p = idx[b];
+            arma::vec::fixed<dim> x = {(double) xs[p], (double) ys[p]};
+
+            gs_mat.zeros();
+            gs_matrix(sup_doms[p], gs_mat);
+
+            rhs_mat.zeros();
+            rhs_matrix(x, sup_doms[p], rhs_mat);
+        }
+        else
+        {
+            gs_mat.eye();
+            rhs_mat.zeros();
+        }
+
+        // Interleave the leading n x n block
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                gs[(j * n + i) * W + b] = gs_mat.at(i, j);
+            }
+        }
+
+        for (size_t c = 0; c < nrhs; c++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                rhs[(c * n + i) * W + b] = rhs_mat.at(i, c);
+            }
+        }
+    }
+
+    // Factorise and solve for [phi, dphi/dx1, dphi/dx2] in lockstep
+    bool ok[W];
+    if constexpr (std::is_same<S, double>::value)
+    {
+        dense::ldlt_factorise_lockstep<W>(gs, n, ok);
+        dense::ldlt_solve_lockstep<W>(gs, n, rhs, nrhs);
+    }
+    else
+    {
+        solve_lockstep_mixed<W>(n, ok);
+        m_mixed_stats.solves += lanes;
+    }
+
+    for (size_t b = 0; b < lanes; b++)
+    {
+        size_t p = idx[b];
+
+        // De-interleave the solution
+        for (size_t c = 0; c < nrhs; c++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                rhs_mat.at(i, c) = rhs[(c * n + i) * W + b];
+            }
+        }
+
+        if (!ok[b])
+        {
+            bool factorised = false;
+
+            // Mixed precision failure; pivoted double precision factors
+            if constexpr (!std::is_same<S, double>::value)
+            {
+                m_mixed_stats.fallbacks++;
+
+                for (size_t j = 0; j < n; j++)
+                {
+                    for (size_t i = j; i < n; i++)
+                    {
+                        gs_mat.at(i, j) = gs[(j * n + i) * W + b];
+                    }
+                }
+
+                for (size_t c = 0; c < nrhs; c++)
+                {
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        rhs_mat.at(i, c) = m_ws.batch_rhs0[(c * n + i) * W + b];
+                    }
+                }
+
+                dense::Pivot piv[N];
+                factorised = dense::ldlt_factorise_pivoted(gs_mat, n, piv);
+                if (factorised)
+                {
+                    dense::ldlt_solve_pivoted(gs_mat, n, piv, rhs_mat);
+                }
+            }
+
+            // Zero pivot or element growth; solve this point on its own (pivoted)
+            if (!factorised)
+            {
+                arma::vec::fixed<dim> x = {(double) xs[p], (double) ys[p]};
+                calculate_system(x, sup_doms[p], phis_strs[p], nullptr);
+                continue;
+            }
+        }
+
+        set_measures(rhs_mat, sup_doms[p].size(), phis_strs[p]);
+    }
+}
+
+// Solve the lockstep systems in mixed precision
+template <typename Rbf>
+template <size_t W>
+void ShapeFunction<Rbf>::solve_lockstep_mixed(size_t n, bool* ok)
+{
+    constexpr size_t nrhs = dim + 1;
+
+    const double* gs = m_ws.batch_gs.data();
+    double* rhs = m_ws.batch_rhs.data();
+
+    // Single precision copy of the matrices
+    m_ws.batch_gs_float.resize(n * n * W);
+    float* gs_float = m_ws.batch_gs_float.data();
+
+    // Denormals are flushed while in this scope
+    dense::FlushDenormals flush_denormals;
+
+    #pragma omp simd
+    for (size_t k = 0; k < n * n * W; k++)
+    {
+        gs_float[k] = (float) gs[k];
+    }
+
+    // Right hand sides (kept for the residuals)
+    m_ws.batch_rhs0.assign(rhs, rhs + n * nrhs * W);
+    m_ws.batch_res.resize(n * nrhs * W);
+    const double* rhs0 = m_ws.batch_rhs0.data();
+    double* res = m_ws.batch_res.data();
+
+    dense::ldlt_factorise_lockstep<W>(gs_float, n, ok);
+    dense::ldlt_solve_lockstep<W>(gs_float, n, rhs, nrhs);
+
+    // Infinity norms of the matrices (symmetric; column sums)
+    double gs_norm[W] = {};
+    for (size_t j = 0; j < n; j++)
+    {
+        double sum[W] = {};
+        for (size_t i = 0; i < n; i++)
+        {
+            const double* a_ij = gs + (j * n + i) * W;
+
+            #pragma omp simd
+            for (size_t b = 0; b < W; b++)
+            {
+                sum[b] += std::abs(a_ij[b]);
+            }
+        }
+
+        for (size_t b = 0; b < W; b++)
+        {
+            gs_norm[b] = std::max(gs_norm[b], sum[b]);
+        }
+    }
+
+    for (size_t step = 0; ; step++)
+    {
+        // Residuals of the current solutions
+        std::copy(rhs0, rhs0 + n * nrhs * W, res);
+        dense::residual_lockstep<W>(gs, n, rhs, res, nrhs);
+
+        // Converged lanes; relative residual of every right hand side
+        bool converged = true;
+        bool lane_converged[W];
+        for (size_t b = 0; b < W; b++)
+        {
+            lane_converged[b] = true;
+
+            for (size_t c = 0; c < nrhs && ok[b]; c++)
+            {
+                double r_norm = 0.0, x_norm = 0.0, b_norm = 0.0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    size_t k = (c * n + i) * W + b;
+                    r_norm = std::max(r_norm, std::abs(res[k]));
+                    x_norm = std::max(x_norm, std::abs(rhs[k]));
+                    b_norm = std::max(b_norm, std::abs(rhs0[k]));
+                }
+
+                // Not finite residuals fail the test
+                if (!(r_norm <= refinement_tol * (gs_norm[b] * x_norm + b_norm)))
+                {
+                    lane_converged[b] = false;
+                }
+            }
+
+            converged = converged && (lane_converged[b] || !ok[b]);
+        }
+
+        if (converged || step == max_refinements)
+        {
+            for (size_t b = 0; b < W; b++)
+            {
+                ok[b] = ok[b] && lane_converged[b];
+            }
+
+            return;
+        }
+
+        // Correction; sol += Gs^-1 res
+        dense::ldlt_solve_lockstep<W>(gs_float, n, res, nrhs);
+        m_mixed_stats.refinements++;
+
+        #pragma omp simd
+        for (size_t k = 0; k < n * nrhs * W; k++)
+        {
+            rhs[k] += res[k];
+        }
+    }
+}
+
+// Calculate with workspace storage
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::calculate_dynamic(const arma::dvec& x,
+    const geom::PointSetView<T>& sup_dom, Measures& phis_str,
+    const size_t* support_indices)
+{
+    // Size of the gs system
+    size_t n = sup_dom.size() + m_ms;
+
+    // Gs matrix storage (built on demand) and right hand sides
+    m_ws.gs_mat.set_size(n, n);
+    m_ws.rhs_mat.zeros(n, dim + 1);
+    rhs_matrix(x, sup_dom, m_ws.rhs_mat);
+
+    // Solve gs * sol = rhs (rhs_mat is overwritten by the solution)
+    solve_system(sup_dom, support_indices, m_ws.gs_mat, m_ws.rhs_mat);
+
+    set_measures(m_ws.rhs_mat, sup_dom.size(), phis_str);
+}
+
+// Solve the gs system
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::solve_system(const geom::PointSetView<T>& sup_dom,
+    const size_t* support_indices, arma::dmat& gs_mat, arma::dmat& rhs_mat)
+{
+    // Number of sample points and size of the gs system (without padding)
+    size_t ns = sup_dom.size();
+    size_t n = ns + m_ms;
+
+    /* Reuse the factors of an identical support set, or in stencil reuse
+    mode of an identical stencil shape (sup_dom then holds local coordinates
+    in double) */
+    const FactorisationCache::Factors* factors = nullptr;
+    if (support_indices != nullptr)
+    {
+        factors = m_cache.find(support_indices, ns);
+    }
+    else if constexpr (std::is_same<T, double>::value)
+    {
+        if (m_stencil_reuse)
+        {
+            factors = m_cache.find(sup_dom, m_ws.stencil_tol);
+        }
+    }
+
+    if (factors != nullptr)
+    {
+        if (m_condition_monitor)
+        {
+            record_condition(factors->cond);
+        }
+
+        if (!factors->mixed())
+        {
+            dense::ldlt_solve_pivoted(factors->ldl_view(), n, factors->piv.data(),
+                rhs_mat);
+            return;
+        }
+
+        // Single precision factors, refined against the cached gs
+        if (refine_mixed(factors->ldl_float_view(), factors->piv.data(),
+            factors->gs_view(), n, rhs_mat))
+        {
+            return;
+        }
+
+        // Not converged; factorised in double precision below (not cached)
+        m_mixed_stats.fallbacks++;
+    }
 
     // Calculate gs matrix
-    arma::dmat gs_mat = gs_matrix(sup_dom);
+    gs_mat.zeros();
+    gs_matrix(sup_dom, gs_mat);
 
-    // Calculate gs inverse 
-    arma::dmat gs_tilde_mat = arma::inv(gs_mat);
+    // The factors of support sets and stencil shapes are cached
+    bool cached = factors == nullptr && (support_indices != nullptr ||
+        (m_stencil_reuse && std::is_same<T, double>::value));
 
-    // Initialize i2 mat
-    arma::dmat i2 = arma::eye(x.n_rows, x.n_rows);
+    // Single precision factors with double precision refinement
+    if (m_mixed_precision && !m_condition_monitor && factors == nullptr)
+    {
+        if (solve_mixed(gs_mat, n, rhs_mat))
+        {
+            if (cached && support_indices != nullptr)
+            {
+                m_cache.insert(support_indices, ns, m_ws.gs_float, gs_mat,
+                    m_ws.pivots.data(), n);
+            }
+            else if constexpr (std::is_same<T, double>::value)
+            {
+                if (cached)
+                {
+                    m_cache.insert(sup_dom, m_ws.gs_float, gs_mat,
+                        m_ws.pivots.data(), n);
+                }
+            }
 
-    // PARALLELISE
-    // Loop through support domain points
-    for (size_t i = 0; i < ns; i++)
+            return;
+        }
+
+        m_mixed_stats.fallbacks++;
+    }
+
+    // 1-norm of gs for the condition estimate
+    double gs_norm = m_condition_monitor ? dense::norm1_symmetric(gs_mat, n) : 0.0;
+
+    m_ws.pivots.resize(n);
+    dense::Pivot* piv = m_ws.pivots.data();
+
+    /* Gs is symmetric indefinite; factorise once with Bunch-Kaufman pivoting
+    and solve for [phi, dphi/dx1, dphi/dx2]. Compact kernels give a sparse gs
+    with a positive definite rbf block, which is first eliminated without
+    pivoting, skipping its zeros. */
+    bool factorised = false;
+    if constexpr (Rbf::compact)
     {
-        // Caclulate the first sum
-        double sum1 = 0;
-        arma::drowvec sum1_jac = arma::zeros<arma::drowvec>(1, x.n_rows);
+        m_ws.sparse_rows.resize(n);
+        factorised = dense::ldlt_factorise_sparse(gs_mat, n, m_ws.sparse_rows.data());
 
-        for (size_t j = 0; j < ns; j++)
+        if (factorised)
         {
-            sum1 += ri_vecjac.vec.at(j) * gs_tilde_mat.at(j, i);
-            sum1_jac += ri_vecjac.jac.row(j) * gs_tilde_mat.at(j, i);
+            for (size_t k = 0; k < n; k++)
+            {
+                piv[k] = (dense::Pivot) k;
+            }
         }
-        
-        // Caclulate the second sum
-        double sum2 = 0.0;
-        arma::drowvec sum2_jac = arma::zeros<arma::drowvec>(1, x.n_rows);
-        for (size_t k = 0; k < m_ms; k++)
+        else
         {
-            sum2 += pi_vecjac.vec.at(k) * gs_tilde_mat.at(ns+k, i);
-            sum2_jac += pi_vecjac.jac.row(k) * gs_tilde_mat.at(ns+k, i);
+            // Element growth; rebuild gs for the pivoted factorisation
+            gs_mat.zeros();
+            gs_matrix(sup_dom, gs_mat);
         }
+    }
 
-        // Construct vector and jacobian
-        phis_str.phis_vec.at(i) = sum1 + sum2;
-        phis_str.phis_jac.row(i) = sum1_jac + sum2_jac;
+    if (!factorised)
+    {
+        factorised = dense::ldlt_factorise_pivoted(gs_mat, n, piv);
+    }
+
+    if (factorised)
+    {
+        // Condition estimate from the factors
+        double cond = 0.0;
+        if (m_condition_monitor)
+        {
+            m_ws.cond_x.set_size(n);
+            m_ws.cond_z.set_size(n);
+            cond = gs_norm * dense::ldlt_inv_norm1_estimate(gs_mat, n, piv,
+                m_ws.cond_x, m_ws.cond_z);
+            record_condition(cond);
+        }
 
-        // Calculate Phis matrix
-        phis_str.phis_mat.cols(2*i, 2*i+1) =  phis_str.phis_vec.at(i) * i2;
+        if (cached && support_indices != nullptr)
+        {
+            m_cache.insert(support_indices, ns, gs_mat, piv, n, cond);
+        }
+        else if constexpr (std::is_same<T, double>::value)
+        {
+            if (cached)
+            {
+                m_cache.insert(sup_dom, gs_mat, piv, n, cond);
+            }
+        }
+
+        dense::ldlt_solve_pivoted(gs_mat, n, piv, rhs_mat);
+        return;
+    }
+
+    // Singular gs; rebuild gs and fall back to a least squares solve
+    gs_mat.zeros();
+    gs_matrix(sup_dom, gs_mat);
+
+    // Condition estimate of the (unpadded) gs; infinite if singular
+    if (m_condition_monitor)
+    {
+        double rcond = arma::rcond(arma::dmat(gs_mat.submat(0, 0, n - 1, n - 1)));
+        record_condition(rcond > 0.0 ? 1.0 / rcond :
+            std::numeric_limits<double>::infinity());
+    }
+
+    arma::dmat rhs_copy = rhs_mat;
+    arma::solve(rhs_mat, gs_mat, rhs_copy);
+}
+
+// Solve the gs system in mixed precision
+template <typename Rbf>
+bool ShapeFunction<Rbf>::solve_mixed(const arma::dmat& gs_mat, size_t n,
+    arma::dmat& rhs_mat)
+{
+    // Single precision copy of the lower triangle
+    arma::fmat& gs_float = m_ws.gs_float;
+    gs_float.set_size(n, n);
+
+    // Denormals are flushed while in this scope
+    dense::FlushDenormals flush_denormals;
+
+    for (size_t j = 0; j < n; j++)
+    {
+        for (size_t i = j; i < n; i++)
+        {
+            gs_float.at(i, j) = (float) gs_mat.at(i, j);
+        }
+    }
+
+    m_mixed_stats.solves++;
+    m_ws.pivots.resize(n);
+    dense::Pivot* piv = m_ws.pivots.data();
+    if (!dense::ldlt_factorise_pivoted(gs_float, n, piv))
+    {
+        return false;
     }
 
-    return phis_str;
+    return refine_mixed(gs_float, piv, gs_mat, n, rhs_mat);
+}
+
+// Refine a single precision solve
+template <typename Rbf>
+template <typename FactorsType, typename GsType>
+bool ShapeFunction<Rbf>::refine_mixed(const FactorsType& ldl_float,
+    const dense::Pivot* piv, const GsType& gs, size_t n, arma::dmat& rhs_mat)
+{
+    // Denormals are flushed while in this scope
+    dense::FlushDenormals flush_denormals;
+
+    // Right hand sides (kept for the residuals)
+    m_ws.rhs_copy = rhs_mat;
+    dense::ldlt_solve_pivoted(ldl_float, n, piv, rhs_mat);
+
+    // Infinity norm of gs (symmetric; column sums)
+    double gs_norm = dense::norm1_symmetric(gs, n);
+
+    arma::dmat& res_mat = m_ws.res_mat;
+    for (size_t step = 0; ; step++)
+    {
+        // Residuals of the current solution
+        res_mat = m_ws.rhs_copy;
+        dense::symmetric_residual(gs, n, rhs_mat, res_mat);
+
+        // Relative residual of every right hand side
+        bool converged = true;
+        for (size_t c = 0; c < rhs_mat.n_cols; c++)
+        {
+            double r_norm = 0.0, x_norm = 0.0, b_norm = 0.0;
+            for (size_t i = 0; i < n; i++)
+            {
+                r_norm = std::max(r_norm, std::abs(res_mat.at(i, c)));
+                x_norm = std::max(x_norm, std::abs(rhs_mat.at(i, c)));
+                b_norm = std::max(b_norm, std::abs(m_ws.rhs_copy.at(i, c)));
+            }
+
+            // Not finite residuals fail the test
+            if (!(r_norm <= refinement_tol * (gs_norm * x_norm + b_norm)))
+            {
+                converged = false;
+            }
+        }
+
+        if (converged)
+        {
+            return true;
+        }
+
+        if (step == max_refinements)
+        {
+            rhs_mat = m_ws.rhs_copy;
+            return false;
+        }
+
+        // Correction; sol += Gs^-1 res
+        dense::ldlt_solve_pivoted(ldl_float, n, piv, res_mat);
+        m_mixed_stats.refinements++;
+
+        for (size_t c = 0; c < rhs_mat.n_cols; c++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                rhs_mat.at(i, c) += res_mat.at(i, c);
+            }
+        }
+    }
+}
+
+// Copy measures from the solution
+template <typename Rbf>
+void ShapeFunction<Rbf>::set_measures(const arma::dmat& sol_mat, size_t ns,
+    Measures& phis_str) const
+{
+    // Initialize measures stucture
+    phis_str.phis_vec.set_size(ns);
+    phis_str.phis_jac.set_size(ns, dim);
+
+    for (size_t i = 0; i < ns; i++)
+    {
+        phis_str.phis_vec.at(i) = sol_mat.at(i, 0);
+
+        for (size_t a = 0; a < dim; a++)
+        {
+            phis_str.phis_jac.at(i, a) = sol_mat.at(i, a + 1);
+        }
+    }
+}
+
+// Right hand sides
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::rhs_matrix(const arma::dvec& x,
+    const geom::PointSetView<T>& sup_dom, arma::dmat& rhs_mat)
+{
+    // Number of sample points
+    size_t ns = sup_dom.size();
+
+    // ri and pi vectors and jacobians
+    VecJac& ri_vecjac = m_ws.ri_vecjac;
+    VecJac& pi_vecjac = m_ws.pi_vecjac;
+    radial_basis(x, sup_dom, ri_vecjac);
+
+    // Polynomial basis about the first support node (as in gs_matrix)
+    bool active[6];
+    if (m_ms > 0)
+    {
+        polynomial2D_basis(x, (double) sup_dom.x[0], (double) sup_dom.y[0],
+            pi_vecjac);
+        polynomial_terms_active(sup_dom, active);
+    }
+
+    for (size_t j = 0; j < ns; j++)
+    {
+        rhs_mat.at(j, 0) = ri_vecjac.vec.at(j);
+
+        for (size_t a = 0; a < dim; a++)
+        {
+            rhs_mat.at(j, a + 1) = ri_vecjac.jac.at(j, a);
+        }
+    }
+
+    for (size_t k = 0; k < m_ms; k++)
+    {
+        // Dropped terms keep a zero right hand side
+        if (!active[k])
+        {
+            continue;
+        }
+
+        rhs_mat.at(ns + k, 0) = pi_vecjac.vec.at(k);
+
+        for (size_t a = 0; a < dim; a++)
+        {
+            rhs_mat.at(ns + k, a + 1) = pi_vecjac.jac.at(k, a);
+        }
+    }
 }
 
 // Gs matrix
-arma::dmat ShapeFunction::gs_matrix(const std::vector<arma::dvec>& sup_dom)
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::gs_matrix(const geom::PointSetView<T>& sup_dom,
+    arma::dmat& gs_mat) const
 {
     // Number of sample points
     size_t ns = sup_dom.size();
 
-    // Initialize Rs_tilde matrix
-    arma::dmat rs_tilde  = arma::zeros(ns, ns);
+    // Local origin of the polynomial basis; first support node
+    double x0 = ns > 0 ? (double) sup_dom.x[0] : 0.0;
+    double y0 = ns > 0 ? (double) sup_dom.y[0] : 0.0;
+    double inv_dc = 1.0 / m_dc;
 
-    // Initialize Ps_tilde matrix
-    arma::dmat ps_tilde  = arma::zeros(ns, m_ms);
+    // Polynomial terms of a support node, and the terms kept
+    double p_si[6];
+    bool active[6];
+    if (m_ms > 0 && ns > 0)
+    {
+        polynomial_terms_active(sup_dom, active);
+    }
 
     // PARALLELISE
     for (size_t i = 0; i < ns; i++)
     {
         // Get the support point i
-        arma::dvec x_si = sup_dom.at(i);
+        double x_si = (double) sup_dom.x[i];
+        double y_si = (double) sup_dom.y[i];
 
-        // Calculate the rbf vector of x_si
-        VecJac rs_x_si_vecjac = rbf_mq(x_si, sup_dom);
+        /* Calculate the i column of the rs_tilde matrix (rbf of x_si) on and
+        below the diagonal, and mirror it to the i row (rs_tilde is
+        symmetric) */
+        double* col_i = gs_mat.colptr(i);
+        m_rbf.values(x_si, y_si, sup_dom.x + i, sup_dom.y + i, ns - i,
+            col_i + i);
 
-        // Calculate the polynomial basis vector of x_si
-        VecJac ps_x_si_vecjac = polynomial2D_basis(x_si);
+        for (size_t j = i + 1; j < ns; j++)
+        {
+            gs_mat.at(i, j) = col_i[j];
+        }
 
-        // Calculate the i row of the rs_tilde matrix
-        rs_tilde.row(i) = rs_x_si_vecjac.vec.t();
+        // Calculate the i row of the ps_tilde matirx (polynomial basis of x_si)
+        polynomial_terms((x_si - x0) * inv_dc, (y_si - y0) * inv_dc, p_si);
 
-        // Calculate the i row of the ps_tilde matirx
-        ps_tilde.row(i) = ps_x_si_vecjac.vec.t();
+        for (size_t k = 0; k < m_ms; k++)
+        {
+            if (active[k])
+            {
+                gs_mat.at(i, ns + k) = p_si[k];
+                gs_mat.at(ns + k, i) = p_si[k];
+            }
+        }
     }
 
-    // Construct gs matrix
-    arma::dmat gs_rows1 = arma::join_horiz(rs_tilde, ps_tilde);
-    arma::dmat gs_rows2 = arma::join_horiz(ps_tilde.t(), arma::zeros(m_ms, m_ms));
+    // Identity padding of the dropped terms
+    for (size_t k = 0; k < m_ms && ns > 0; k++)
+    {
+        if (!active[k])
+        {
+            gs_mat.at(ns + k, ns + k) = 1.0;
+        }
+    }
 
-    return arma::join_vert(gs_rows1, gs_rows2);
+    // Identity padding
+    for (size_t i = ns + m_ms; i < gs_mat.n_rows; i++)
+    {
+        gs_mat.at(i, i) = 1.0;
+    }
 }
 
-// Radial basis function (multi-quadrics)
-ShapeFunction::VecJac ShapeFunction::rbf_mq(const arma::dvec& x,
-    const std::vector<arma::dvec>& sup_dom)
+// Radial basis function
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::radial_basis(const arma::dvec& x,
+    const geom::PointSetView<T>& sup_dom, VecJac& vec_jac) const
 {
-    // Initialzie vedjac
-    VecJac vec_jac; 
-
     // Get support domain size
     size_t ns = sup_dom.size();
 
     // Initialize vector and jacobian
-    vec_jac.vec = arma::zeros<arma::dvec>(ns, 1);
+    vec_jac.vec.set_size(ns);
+    vec_jac.jac.set_size(ns, dim);
 
-    vec_jac.jac = arma::zeros<arma::dmat>(ns, x.n_rows);
+    // Batched kernel; the jacobian columns are contiguous
+    m_rbf.evaluate(x(0), x(1), sup_dom.x, sup_dom.y, ns, vec_jac.vec.memptr(),
+        vec_jac.jac.colptr(0), vec_jac.jac.colptr(1));
+}
+
+// Polynomial terms
+template <typename Rbf>
+void ShapeFunction<Rbf>::polynomial_terms(double u, double v, double* p) const
+{
+    if (m_ms >= 3)
+    {
+        p[0] = 1.0; p[1] = u; p[2] = v;
+    }
+
+    if (m_ms == 6)
+    {
+        p[3] = u * u; p[4] = u * v; p[5] = v * v;
+    }
+}
+
+// Polynomial terms resolved by the support nodes
+template <typename Rbf>
+template <typename T>
+void ShapeFunction<Rbf>::polynomial_terms_active(const
+    geom::PointSetView<T>& sup_dom, bool* active) const
+{
+    std::fill(active, active + m_ms, true);
+
+    size_t ns = sup_dom.size();
+    if (m_ms < 6 || ns == 0)
+    {
+        return;
+    }
+
+    // Moment matrix of the basis over the support nodes (lower triangle)
+    double x0 = (double) sup_dom.x[0];
+    double y0 = (double) sup_dom.y[0];
+    double inv_dc = 1.0 / m_dc;
+
+    arma::mat::fixed<6, 6> moment_mat(arma::fill::zeros);
+    double p_si[6];
 
-    // PARALLELISE
     for (size_t i = 0; i < ns; i++)
     {
-        // Get support domain point i 
-        arma::dvec xi = sup_dom.at(i);
+        polynomial_terms(((double) sup_dom.x[i] - x0) * inv_dc,
+            ((double) sup_dom.y[i] - y0) * inv_dc, p_si);
 
-        // D1 function
-        double d1_i = x(0) - xi(0);
+        for (size_t b = 0; b < 6; b++)
+        {
+            for (size_t a = b; a < 6; a++)
+            {
+                moment_mat.at(a, b) += p_si[a] * p_si[b];
+            }
+        }
+    }
 
-        // D2 function
-        double d2_i = x(1) - xi(1);
+    /* LDL^T elimination of the moment matrix; a quadratic term with a
+    vanishing pivot (relative to its diagonal) depends on the previous terms
+    and is eliminated no further */
+    for (size_t j = 0; j < 6; j++)
+    {
+        double diag = moment_mat.at(j, j);
+        for (size_t k = 0; k < j; k++)
+        {
+            if (active[k])
+            {
+                diag -= moment_mat.at(j, k) * moment_mat.at(j, k) *
+                    moment_mat.at(k, k);
+            }
+        }
+
+        if (j >= 3 && diag <= 1.0e-10 * moment_mat.at(j, j))
+        {
+            active[j] = false;
+            continue;
+        }
 
-        // D function
-        double di = pow(d1_i, 2.0) + pow(d2_i, 2.0) + pow(m_ac * m_dc, 2.0);
+        // Column j of L (the diagonal holds D)
+        for (size_t i = j + 1; i < 6; i++)
+        {
+            double l = moment_mat.at(i, j);
+            for (size_t k = 0; k < j; k++)
+            {
+                if (active[k])
+                {
+                    l -= moment_mat.at(i, k) * moment_mat.at(j, k) *
+                        moment_mat.at(k, k);
+                }
+            }
 
-        // Calculate r_vector component
-        vec_jac.vec(i) = pow(di, m_q);
+            moment_mat.at(i, j) = l / diag;
+        }
 
-        // Calculate jacobian
-        arma::dvec jac_row =  {d1_i, d2_i};
-        vec_jac.jac.row(i) = 2.0 * m_q * pow(di, m_q-1) * jac_row.t();
+        moment_mat.at(j, j) = diag;
     }
-    
-    return vec_jac;
 }
 
-// Polynomial function (linear basis in 2D)
-ShapeFunction::VecJac ShapeFunction::polynomial2D_basis(const arma::dvec& x)
+// Polynomial function (linear or quadratic basis in 2D)
+template <typename Rbf>
+void ShapeFunction<Rbf>::polynomial2D_basis(const arma::dvec& x, double x0,
+    double y0, VecJac& vec_jac) const
 {
-    // Initialzie vedjac
-    VecJac vec_jac; 
+    vec_jac.vec.set_size(m_ms);
+    vec_jac.jac.zeros(m_ms, dim);
 
-    if (m_ms == 3)
+    if (m_ms == 0)
     {
-        vec_jac.vec = {1, x(0), x(1)};
-        vec_jac.jac = {{0.0, 0.0}, {1.0, 0.0}, {0.0, 1.0}};
+        return;
     }
-    else
+
+    // Scaled local coordinates; du/dx = dv/dy = 1 / dc
+    double s = 1.0 / m_dc;
+    double u = (x(0) - x0) * s;
+    double v = (x(1) - y0) * s;
+
+    polynomial_terms(u, v, vec_jac.vec.memptr());
+
+    vec_jac.jac.at(1, 0) = s; vec_jac.jac.at(2, 1) = s;
+
+    if (m_ms == 6)
     {
-        arma::dvec a; vec_jac.vec = a;
-        arma::dmat a_jac; vec_jac.jac = a_jac; 
+        vec_jac.jac.at(3, 0) = 2.0 * u * s;
+        vec_jac.jac.at(4, 0) = v * s; vec_jac.jac.at(4, 1) = u * s;
+        vec_jac.jac.at(5, 1) = 2.0 * v * s;
     }
+}
+
+// Explicit instantiations
+#define SHAPE_FUNCTION_INSTANTIATIONS(Rbf, T) \
+    template void ShapeFunction<Rbf>::radial_basis<T>(const arma::dvec&, \
+        const geom::PointSetView<T>&, VecJac&) const; \
+    template void ShapeFunction<Rbf>::calculate<T>(const arma::dvec&, \
+        const geom::PointSetView<T>&, Measures&, const size_t*); \
+    template void ShapeFunction<Rbf>::calculate_batch<T>(const T*, const T*, \
+        const geom::PointSetView<T>*, size_t, Measures*);
+
+template class ShapeFunction<rbf::Multiquadric>;
+template class ShapeFunction<rbf::Gaussian>;
+template class ShapeFunction<rbf::ThinPlateSpline>;
+template class ShapeFunction<rbf::WendlandC2>;
+template class ShapeFunction<rbf::WendlandC4>;
+
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::Multiquadric, float)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::Multiquadric, double)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::Gaussian, float)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::Gaussian, double)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::ThinPlateSpline, float)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::ThinPlateSpline, double)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::WendlandC2, float)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::WendlandC2, double)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::WendlandC4, float)
+SHAPE_FUNCTION_INSTANTIATIONS(rbf::WendlandC4, double)
 
-    return vec_jac;
-}
\ No newline at end of file
+#undef SHAPE_FUNCTION_INSTANTIATIONS
@@ -0,0 +1,137 @@
+#include "../include/shape_tuner.h"
+
+template <typename T, typename Rbf>
+ShapeTuner<T, Rbf>::ShapeTuner(const geom::RPIMParameters& rpim_params, int ms,
+    const ShapeTunerSettings& settings) : m_settings(settings),
+    m_sf(rpim_params.as, rpim_params.dc, rpim_params.q, ms)
+{
+    // Record a condition estimate per support domain
+    m_sf.set_condition_monitor(true);
+}
+
+// Tune the whole table
+template <typename T, typename Rbf>
+double ShapeTuner<T, Rbf>::tune(const
+    typename SupportDomain<T>::SupportDomainTable& sd_table)
+{
+    std::vector<size_t> points(sd_table.size());
+    std::iota(points.begin(), points.end(), 0);
+
+    return tune(sd_table, points);
+}
+
+// Tune a subset of the table
+template <typename T, typename Rbf>
+double ShapeTuner<T, Rbf>::tune(const
+    typename SupportDomain<T>::SupportDomainTable& sd_table,
+    const std::vector<size_t>& points)
+{
+    // Sample the points evenly
+    std::vector<size_t> sample;
+    size_t samples = m_settings.samples;
+    size_t stride = (samples == 0 || points.size() <= samples) ? 1 :
+        points.size() / samples;
+
+    for (size_t k = 0; k < points.size(); k += stride)
+    {
+        sample.push_back(points[k]);
+    }
+
+    // Log spaced candidates
+    size_t candidates = std::max(m_settings.candidates, (size_t) 2);
+    double ratio = std::log(m_settings.ac_max / m_settings.ac_min) /
+        (candidates - 1);
+
+    std::vector<double> acs(candidates), conds(candidates);
+    for (size_t k = 0; k < candidates; k++)
+    {
+        acs[k] = m_settings.ac_min * std::exp(ratio * k);
+        conds[k] = max_condition(sd_table, sample, acs[k]);
+    }
+
+    // Admissible candidate closest to the bound
+    size_t best = candidates;
+    for (size_t k = 0; k < candidates; k++)
+    {
+        if (conds[k] <= m_settings.max_condition &&
+            (best == candidates || conds[k] > conds[best]))
+        {
+            best = k;
+        }
+    }
+
+    // None admissible; best conditioned candidate
+    if (best == candidates)
+    {
+        return acs[std::min_element(conds.begin(), conds.end()) - conds.begin()];
+    }
+
+    // Inadmissible neighbour with the largest estimate brackets the bound
+    size_t other = candidates;
+    for (size_t k : {best - 1, best + 1})
+    {
+        if (k < candidates && conds[k] > m_settings.max_condition &&
+            (other == candidates || conds[k] > conds[other]))
+        {
+            other = k;
+        }
+    }
+
+    double ac_best = acs[best], cond_best = conds[best];
+    if (other == candidates)
+    {
+        return ac_best;
+    }
+
+    // Bisection (in log scale) towards the bound
+    double ac_other = acs[other];
+    for (size_t i = 0; i < m_settings.refinements; i++)
+    {
+        double ac_mid = std::sqrt(ac_best * ac_other);
+        double cond_mid = max_condition(sd_table, sample, ac_mid);
+
+        if (cond_mid <= m_settings.max_condition && cond_mid >= cond_best)
+        {
+            ac_best = ac_mid;
+            cond_best = cond_mid;
+        }
+        else
+        {
+            ac_other = ac_mid;
+        }
+    }
+
+    return ac_best;
+}
+
+// Largest condition estimate of the sampled support domains
+template <typename T, typename Rbf>
+double ShapeTuner<T, Rbf>::max_condition(const
+    typename SupportDomain<T>::SupportDomainTable& sd_table,
+    const std::vector<size_t>& points, double ac)
+{
+    m_sf.set_shape_constant(ac);
+    m_sf.reset_condition_stats(m_settings.max_condition);
+
+    for (size_t idx : points)
+    {
+        typename SupportDomain<T>::SupportDomainPoint sup_dom = sd_table.at(idx);
+        arma::vec::fixed<2> x = {(double) sup_dom.point_x, (double) sup_dom.point_y};
+
+        m_sf.calculate(x, sup_dom.support_coords, m_phis);
+    }
+
+    return m_sf.get_condition_stats().max;
+}
+
+// Explicit instantiations
+template class ShapeTuner<float, rbf::Multiquadric>;
+template class ShapeTuner<double, rbf::Multiquadric>;
+template class ShapeTuner<float, rbf::Gaussian>;
+template class ShapeTuner<double, rbf::Gaussian>;
+template class ShapeTuner<float, rbf::ThinPlateSpline>;
+template class ShapeTuner<double, rbf::ThinPlateSpline>;
+template class ShapeTuner<float, rbf::WendlandC2>;
+template class ShapeTuner<double, rbf::WendlandC2>;
+template class ShapeTuner<float, rbf::WendlandC4>;
+template class ShapeTuner<double, rbf::WendlandC4>;
@@ -1,35 +1,151 @@
 #include "../include/strain.h"
+#include "../include/stiffness_kernels.h"
 
 // Set shape function
-void Strain::set_shape_function(const ShapeFunction::Measures& sf)
+template <size_t Dim, size_t Dofs>
+void Strain<Dim, Dofs>::set_shape_function(const shape::Measures& sf)
 {
     // Store shape function to member variable
-    m_sf_s = sf;
+    m_sf_s = &sf;
 
     // Gen number of support domain points
     m_ns = sf.phis_vec.size();
 }
 
 // Update function
-void Strain::update(const arma::dvec& es)
+template <size_t Dim, size_t Dofs>
+void Strain<Dim, Dofs>::update(const arma::dvec& es)
 {
     // Phis jac
-    arma::dmat phis_jac = m_sf_s.phis_jac;
+    const arma::dmat& phis_jac = m_sf_s->phis_jac;
 
-    // Initialize Ds matrix 
-    m_ds_matrix = arma::zeros<arma::dmat>(3, 2 * m_ns);
+    constexpr auto entries = ds_entries();
 
-    // Calculate Ds matrix
+    // strain = sum_i Di_s * es_i
+    m_strain_vector.zeros();
     for (size_t i = 0; i < m_ns; i++)
     {
-        double dphi_is_x1 = phis_jac.at(i, 0);
-        double dphi_is_x2 = phis_jac.at(i, 1);
+        for (const DsEntry& e : entries)
+        {
+            m_strain_vector.at(e.row) += phis_jac.at(i, e.deriv) *
+                es.at(Dofs*i + e.comp);
+        }
+    }
+}
+
+// Apply the transposed strain operator
+template <size_t Dim, size_t Dofs>
+void Strain<Dim, Dofs>::apply_ds_transpose(const arma::dvec& v,
+    arma::dvec& out) const
+{
+    const arma::dmat& phis_jac = m_sf_s->phis_jac;
+
+    constexpr auto entries = ds_entries();
+
+    // out_i = Di_s^T * v
+    out.zeros(Dofs * m_ns);
+    for (size_t i = 0; i < m_ns; i++)
+    {
+        for (const DsEntry& e : entries)
+        {
+            out.at(Dofs*i + e.comp) += phis_jac.at(i, e.deriv) * v.at(e.row);
+        }
+    }
+}
+
+// Local stiffness
+template <size_t Dim, size_t Dofs>
+void Strain<Dim, Dofs>::ds_congruence(const arma::dmat& c_mat,
+    arma::dmat& out)
+{
+    const arma::dmat& phis_jac = m_sf_s->phis_jac;
+
+    // Plane elasticity without shear coupling; fused kernel
+    if constexpr (Dim == 2 && Dofs == 2)
+    {
+        stiffness::PlaneConstants c;
+        if (stiffness::plane_constants(c_mat, c))
+        {
+            stiffness::local_stiffness(phis_jac.colptr(0), phis_jac.colptr(1),
+                m_ns, c, out);
+            return;
+        }
+    }
+
+    constexpr auto entries = ds_entries();
+
+    // C * Dj_s of every node (memory reused between calls)
+    std::vector<arma::mat::fixed<strain_size, Dofs>>& cd_blocks = m_cd_blocks;
+    cd_blocks.resize(m_ns);
+
+    for (size_t j = 0; j < m_ns; j++)
+    {
+        arma::mat::fixed<strain_size, Dofs>& cd = cd_blocks[j];
+        cd.zeros();
+
+        for (const DsEntry& e : entries)
+        {
+            double d = phis_jac.at(j, e.deriv);
+
+            for (size_t s = 0; s < strain_size; s++)
+            {
+                cd.at(s, e.comp) += c_mat.at(s, e.row) * d;
+            }
+        }
+    }
+
+    // Blocks (i, j >= i) = Di_s^T * (C * Dj_s), mirrored below the diagonal
+    out.set_size(Dofs * m_ns, Dofs * m_ns);
+    for (size_t j = 0; j < m_ns; j++)
+    {
+        const arma::mat::fixed<strain_size, Dofs>& cd = cd_blocks[j];
+
+        for (size_t i = 0; i <= j; i++)
+        {
+            double block[Dofs][Dofs] = {};
+
+            for (const DsEntry& e : entries)
+            {
+                double d = phis_jac.at(i, e.deriv);
+
+                for (size_t b = 0; b < Dofs; b++)
+                {
+                    block[e.comp][b] += d * cd.at(e.row, b);
+                }
+            }
 
-        arma::dmat di_s = {{dphi_is_x1, 0.0}, {0.0, dphi_is_x2}, 
-            {dphi_is_x2, dphi_is_x1}};
+            for (size_t b = 0; b < Dofs; b++)
+            {
+                for (size_t a = 0; a < Dofs; a++)
+                {
+                    out.at(Dofs*i + a, Dofs*j + b) = block[a][b];
+                    out.at(Dofs*j + b, Dofs*i + a) = block[a][b];
+                }
+            }
+        }
+    }
+}
+
+// Ds matrix
+template <size_t Dim, size_t Dofs>
+arma::dmat Strain<Dim, Dofs>::get_ds_matrix(void) const
+{
+    const arma::dmat& phis_jac = m_sf_s->phis_jac;
+
+    constexpr auto entries = ds_entries();
 
-        m_ds_matrix.cols(2*i, 2*i+1) = di_s;
+    arma::dmat ds_matrix(strain_size, Dofs * m_ns, arma::fill::zeros);
+    for (size_t i = 0; i < m_ns; i++)
+    {
+        for (const DsEntry& e : entries)
+        {
+            ds_matrix.at(e.row, Dofs*i + e.comp) = phis_jac.at(i, e.deriv);
+        }
     }
 
-    m_strain_vector = m_ds_matrix * es;
-}
\ No newline at end of file
+    return ds_matrix;
+}
+
+// Explicit instantiations
+template class Strain<2, 2>;
+template class Strain<2, 1>;
@@ -1,137 +1,162 @@
 #include "../include/support_domain.h"
 
 // Generate support domain
-std::vector<SupportDomain::SupportDomainPoint> SupportDomain::generate(
-    const geom::PointCloud<double>& field_nodes,
-    const geom::PointCloud<double>& data_pts,
-    const geom::RPIMParameters& rpim_params, bool animate)
+template <typename T>
+void SupportDomain<T>::generate(const geom::PointCloudSoA<T>& data_pts,
+    size_t field_nodes_num, const geom::RPIMParameters& rpim_params,
+    SupportDomainTable& sup_dom_table, bool animate)
 {
-    // Field nodes threshold index; any index bigger this (for the data_pts) 
-    // is not a field node (aka it is a quadrature point)
-    size_t field_nodes_thresh_idx = field_nodes.pts.size() - 1;
+    // Number of interest points (any data point after the field nodes)
+    size_t inter_pts_num = data_pts.size() - field_nodes_num;
+
+    // Clear previous support domains (memory is kept); the offsets and indices
+    // are overwritten in place to detect a change of the pattern
+    sup_dom_table.point_idx.clear();
+    sup_dom_table.point_x.clear();
+    sup_dom_table.point_y.clear();
+    sup_dom_table.support_x.clear();
+    sup_dom_table.support_y.clear();
+    sup_dom_table.version++;
+    sup_dom_table.point_idx.reserve(inter_pts_num);
+    sup_dom_table.point_x.reserve(inter_pts_num);
+    sup_dom_table.point_y.reserve(inter_pts_num);
+
+    std::vector<size_t>& offsets = sup_dom_table.offsets;
+    std::vector<size_t>& support_indices = sup_dom_table.support_indices;
+    bool pattern_changed = offsets.size() != inter_pts_num + 1;
+    size_t support_num = 0;
+
+    // Overwrite entry pos of a pattern vector
+    auto set_pattern = [&pattern_changed](std::vector<size_t>& v, size_t pos,
+        size_t value)
+    {
+        if (pos < v.size())
+        {
+            pattern_changed = pattern_changed || v[pos] != value;
+            v[pos] = value;
+        }
+        else
+        {
+            pattern_changed = true;
+            v.push_back(value);
+        }
+    };
 
-    // Initialize the vector of support domain points (that's the quadrature points)
-    std::vector<SupportDomainPoint> sup_dom_pts(data_pts.pts.size() -
-        field_nodes.pts.size());
+    offsets.reserve(inter_pts_num + 1);
+    set_pattern(offsets, 0, 0);
 
     // Rectangle width and height
     double width = rpim_params.as * rpim_params.dc_x;
     double height = rpim_params.as * rpim_params.dc_y;
     
     // Define search radius
-    double search_radius = std::sqrt(pow(width/2.0, 2.0) + pow(height/2.0, 2.0));
+    T search_radius = std::sqrt(pow(width/2.0, 2.0) + pow(height/2.0, 2.0));
+
+    // Initialize kd trees over the field nodes (view, no copy)
+    KDTrees<T> kd_trees(data_pts.view(0, field_nodes_num));
 
-    // Initialize kd trees
-    KDTrees kd_trees(field_nodes, data_pts);
+    // Search matches (member, reused between interest points and updates)
+    typename KDTrees<T>::Matches& matches = m_matches;
 
     // Loop through interest points
-    for (size_t query_idx = 0; query_idx < field_nodes.pts.size(); query_idx++)
+    for (size_t k = 0; k < inter_pts_num; k++)
     {
-        // Query point
-        double query_pt[3] = {field_nodes.pts.at(query_idx).x,
-            field_nodes.pts.at(query_idx).y,
-            field_nodes.pts.at(query_idx).z};
+        // Index of the interest point in the data points
+        size_t idx = field_nodes_num + k;
+
+        // Range search around the interest point
+        kd_trees.radius_search(data_pts.point(idx), search_radius, matches);
 
-        std::cout << query_pt[0] << std::endl;
-        std::cout << query_pt[1] << std::endl;
-        std::cout << query_pt[2] << std::endl;
-        std::cout << "================" << std::endl;
+        // Order supporting nodes by index
+        std::sort(matches.begin(), matches.end());
 
-        // Range search
-        std::vector<int> indices = kd_trees.radius_search(query_idx, search_radius);
+        // Set interest point
+        sup_dom_table.point_idx.push_back(idx);
+        sup_dom_table.point_x.push_back(data_pts.x[idx]);
+        sup_dom_table.point_y.push_back(data_pts.y[idx]);
 
-        // Loop through found indices
-        for (size_t i = 0; i < indices.size(); i++)
+        // Push back the indices and coordinates of the supporting field nodes
+        for (const auto& match : matches)
         {
-            // Get the idx 
-            auto idx = indices.at(i);
-
-            // If the idx is for a quadrature point then add the idx of the 
-            // field node to the support domain of the quadrature point
-            if(idx > field_nodes_thresh_idx)
-            {
-                // Define goal index 
-                // size_t goal_idx = idx-field_nodes.pts.size();
-                size_t goal_idx = idx-field_nodes.pts.size();
-
-                // Get the idx position of the field node
-                sup_dom_pts.at(goal_idx).point_idx = idx;
-
-                // Get the coordinates of the gaussian point 
-                geom::Point<double> quadr_pt = data_pts.pts.at(idx);
-                sup_dom_pts.at(goal_idx).point_coords = 
-                    {quadr_pt.x, quadr_pt.y};
-
-                // Push back the index of the field node
-                sup_dom_pts.at(goal_idx).support_indices.push_back(i);
-
-                // Push back the coordinates of the field node
-                sup_dom_pts.at(goal_idx).support_coords.push_back({query_pt[0], query_pt[1]});
-            }
+            set_pattern(support_indices, support_num++, match.first);
+            sup_dom_table.support_x.push_back(data_pts.x[match.first]);
+            sup_dom_table.support_y.push_back(data_pts.y[match.first]);
         }
+
+        // Close support domain k
+        set_pattern(offsets, k + 1, support_num);
+    }
+
+    // Drop the entries of a larger previous pattern
+    pattern_changed = pattern_changed || support_indices.size() != support_num;
+    offsets.resize(inter_pts_num + 1);
+    support_indices.resize(support_num);
+
+    if (pattern_changed)
+    {
+        sup_dom_table.pattern_version++;
     }
 
     // Animate support domain
     if(animate)
     {
-        animate_support_domain(data_pts, field_nodes, sup_dom_pts, width, height);
+        animate_support_domain(data_pts, field_nodes_num, sup_dom_table, width,
+            height);
     }
-
-    return sup_dom_pts;
 }
 
+// Remove all support domains (keeps the allocated memory)
+template <typename T>
+void SupportDomain<T>::SupportDomainTable::clear(void)
+{
+    point_idx.clear(); point_x.clear(); point_y.clear();
+    offsets.clear();
+    support_indices.clear(); support_x.clear(); support_y.clear();
+}
 
-void SupportDomain::animate_support_domain(const geom::PointCloud<double>& cloud,
-    const geom::PointCloud<double>& field_nodes,
-    const std::vector<SupportDomainPoint>& sup_dom_pts, double rect_width,
-    double rect_height)
+template <typename T>
+void SupportDomain<T>::animate_support_domain(const geom::PointCloudSoA<T>& cloud,
+    size_t field_nodes_num, const SupportDomainTable& sup_dom_table,
+    double rect_width, double rect_height)
 {
     // Initialize query point
     std::vector<double> quer_x {0.0};
     std::vector<double> quer_y {0.0};
 
-    // Convert to vector sturcture
-    geom::PointCloudVec<double> field_nodes_vec =
-        geom::conv_pc_to_pc_vec<double>(field_nodes);
+    // Field nodes
+    std::vector<double> field_nodes_x(cloud.x.begin(),
+        cloud.x.begin() + field_nodes_num);
+    std::vector<double> field_nodes_y(cloud.y.begin(),
+        cloud.y.begin() + field_nodes_num);
 
-    geom::PointCloudVec<double> cloud_vec =
-        geom::conv_pc_to_pc_vec<double>(cloud);
+    // Cloud
+    std::vector<double> cloud_x(cloud.x.begin(), cloud.x.end());
+    std::vector<double> cloud_y(cloud.y.begin(), cloud.y.end());
 
     // Calculate plot range
-    m_gp << "set xrange " + gp_utils::plot_range(field_nodes_vec.x) + "\n";
-    m_gp << "set yrange " + gp_utils::plot_range(field_nodes_vec.y) + "\n";
+    m_gp << "set xrange " + gp_utils::plot_range(field_nodes_x) + "\n";
+    m_gp << "set yrange " + gp_utils::plot_range(field_nodes_y) + "\n";
     m_gp << "set size ratio -1\n";
 
     // Loop throught quadrature points
-    for (size_t i = 0; i < sup_dom_pts.size(); i++)
+    for (size_t i = 0; i < sup_dom_table.size(); i++)
     {
-        // Get index of quadrature point i 
-        size_t quadr_pt_idx = sup_dom_pts.at(i).point_idx;
-
-        // Get quadrature point i 
-        geom::Point<double> quadr_pt = cloud.pts.at(quadr_pt_idx);
+        // Support domain of quadrature point i
+        SupportDomainPoint sup_dom_i = sup_dom_table.at(i);
 
         // Query point
-        quer_x.at(0) = quadr_pt.x;
-        quer_y.at(0) = quadr_pt.y;
+        quer_x.at(0) = sup_dom_i.point_x;
+        quer_y.at(0) = sup_dom_i.point_y;
 
         // Rectangle
-        auto rect_pc = rectangle(quadr_pt.x, quadr_pt.y, rect_width, rect_height);
+        auto rect_pc = rectangle(sup_dom_i.point_x, sup_dom_i.point_y,
+            rect_width, rect_height);
 
         // Support domain structure
-        std::vector<double> sup_dom_x, sup_dom_y;
-
-        for (size_t k = 0; k < sup_dom_pts.at(i).support_indices.size(); k++)
-        {
-            // Support point (field node)
-           size_t sup_idx = sup_dom_pts.at(i).support_indices.at(k);
-           geom::Point<double> sup_point = cloud.pts.at(sup_idx);
-
-            // Push support point coordinates to support vector
-            sup_dom_x.push_back(sup_point.x);
-            sup_dom_y.push_back(sup_point.y);
-            
-        }
+        std::vector<double> sup_dom_x(sup_dom_i.support_coords.x,
+            sup_dom_i.support_coords.x + sup_dom_i.ns);
+        std::vector<double> sup_dom_y(sup_dom_i.support_coords.y,
+            sup_dom_i.support_coords.y + sup_dom_i.ns);
 
         /************************* Animate ******************************/
 
@@ -147,8 +172,8 @@ void SupportDomain::animate_support_domain(const geom::PointCloud<double>& cloud
         m_gp << plot_str;
 
         // Send data
-        m_gp.send1d(boost::make_tuple(cloud_vec.x, cloud_vec.y));
-        m_gp.send1d(boost::make_tuple(field_nodes_vec.x, field_nodes_vec.y));
+        m_gp.send1d(boost::make_tuple(cloud_x, cloud_y));
+        m_gp.send1d(boost::make_tuple(field_nodes_x, field_nodes_y));
         m_gp.send1d(boost::make_tuple(quer_x, quer_y));
         m_gp.send1d(boost::make_tuple(rect_pc.x, rect_pc.y));
         m_gp.send1d(boost::make_tuple(sup_dom_x, sup_dom_y));
@@ -159,7 +184,8 @@ void SupportDomain::animate_support_domain(const geom::PointCloud<double>& cloud
 }
 
 // Pointcloud to GpointCloud
-std::vector<K::Point_2> SupportDomain::conv_pc_to_gpc(const geom::PointCloud<double>& pc)
+template <typename T>
+std::vector<K::Point_2> SupportDomain<T>::conv_pc_to_gpc(const geom::PointCloud<double>& pc)
 {
     // Initialize G pointcloud
     std::vector<K::Point_2> g_pc;
@@ -175,7 +201,8 @@ std::vector<K::Point_2> SupportDomain::conv_pc_to_gpc(const geom::PointCloud<dou
 }
 
 // Rectangle structure
-geom::PointCloudVec<double> SupportDomain::rectangle(double x_center, double y_center,
+template <typename T>
+geom::PointCloudVec<double> SupportDomain<T>::rectangle(double x_center, double y_center,
     double width, double height)
 {
     // Pointcloud initialisation
@@ -203,7 +230,8 @@ geom::PointCloudVec<double> SupportDomain::rectangle(double x_center, double y_c
 
 
 // Get equal index
-size_t SupportDomain::get_equal_idx(const K::Point_2& inter_point, const
+template <typename T>
+size_t SupportDomain<T>::get_equal_idx(const K::Point_2& inter_point, const
     std::vector<K::Point_2>& data_pts, double tol)
 {
     // Initialize idx
@@ -222,4 +250,8 @@ size_t SupportDomain::get_equal_idx(const K::Point_2& inter_point, const
         }
     }
     return idx;
-}
\ No newline at end of file
+}
+
+// Explicit instantiations
+template class SupportDomain<float>;
+template class SupportDomain<double>;